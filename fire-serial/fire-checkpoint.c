@@ -0,0 +1,271 @@
+/* Checkpoint and restart for the forest fire model.
+
+   Every few time steps the whole state of the simulation - parameters,
+   CurStep, NBurnedTrees, the state of random(), Trees and NewTrees - is
+   written to a checkpoint file. To avoid stalling the stepping loop, the
+   program fork()s and the child process writes the file from its
+   copy-on-write snapshot of memory while the parent keeps stepping. The
+   child writes to FILE.tmp and renames it over FILE when done, so FILE
+   always holds a complete checkpoint even if the job is killed.
+
+   On restart the file is mapped into memory copy-on-write, and Trees and
+   NewTrees point straight into the mapping, so nothing is read or copied
+   up front; pages are loaded as the first time step touches them.
+   */
+
+#include <fcntl.h> /* open() */
+#include <stdlib.h> /* random(), setstate(), exit(), _exit() */
+#include <string.h> /* memcpy(), memcmp(), strlen() */
+#include <sys/mman.h> /* mmap(), msync(), munmap() */
+#include <sys/stat.h> /* fstat() */
+#include <sys/wait.h> /* waitpid() */
+#include <unistd.h> /* fork(), ftruncate(), close() */
+#include "fire-serial.h"
+
+/* Define the characters at the start of every checkpoint file */
+#define CHECKPOINT_MAGIC "FIRECKP2"
+#define CHECKPOINT_MAGIC_LENGTH 8
+
+/* Tree arrays start on a multiple of this many bytes in the file */
+#define CHECKPOINT_ALIGNMENT 4096
+
+struct CheckpointHeader {
+  char magic[CHECKPOINT_MAGIC_LENGTH];
+  int32_t nRows;
+  int32_t nCols;
+  int32_t burnProb;
+  int32_t nMaxBurnSteps;
+  int32_t nSteps;
+  int32_t randSeed;
+  int32_t isCounterRand;
+  int32_t engine; /* enum Engine in fire-serial.c */
+  int32_t curStep; /* The time step to resume at */
+  int64_t nBurnedTrees;
+  int64_t nNewTrees; /* Number of ints in NewTrees */
+  int64_t treesOffset; /* Byte offset of Trees in the file */
+  int64_t newTreesOffset; /* Byte offset of NewTrees in the file */
+  uint32_t randState[RAND_STATE_WORDS]; /* State of random() */
+};
+
+static pid_t WriterPid = 0; /* Child writing a checkpoint, or 0 */
+static void *Mapping = NULL; /* Checkpoint mapped by MapCheckpoint() */
+static size_t MappingSize;
+
+/* Round a byte offset up to CHECKPOINT_ALIGNMENT
+
+   @param offset The offset
+   @return The rounded offset
+   */
+static int64_t AlignOffset(const int64_t offset) {
+  return (offset + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT *
+    CHECKPOINT_ALIGNMENT;
+}
+
+/* Check that nInts ints starting offset bytes into the mapped checkpoint
+   lie within it
+
+   @param offset The byte offset of the first int
+   @param nInts The number of ints
+   @return Whether they are all inside the mapping
+   */
+static bool IsInMapping(const int64_t offset, const int64_t nInts) {
+  return offset >= (int64_t)sizeof(struct CheckpointHeader) &&
+    offset <= (int64_t)MappingSize && nInts >= 0 &&
+    nInts <= ((int64_t)MappingSize - offset) / (int64_t)sizeof(int);
+}
+
+/* Wait for the child writing the last checkpoint, if any, and warn if it
+   failed */
+void WaitForCheckpoint() {
+  int status;
+
+  if (WriterPid > 0) {
+    if (waitpid(WriterPid, &status, 0) != WriterPid || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "WARNING: writing a checkpoint failed\n");
+    }
+    WriterPid = 0;
+  }
+}
+
+/* Write the checkpoint file from the child process
+
+   @param filename The checkpoint file
+   @param engine The selected engine
+   @param nNewTrees The number of ints in NewTrees
+   @return Whether the file was written
+   */
+static bool WriteCheckpointFile(const char *filename, const int engine,
+    const int64_t nNewTrees) {
+  char tmpFilename[4096];
+  struct CheckpointHeader *header;
+  const int64_t treesOffset = AlignOffset(sizeof(struct CheckpointHeader));
+  const int64_t newTreesOffset = AlignOffset(treesOffset +
+      (int64_t)NTreesPlusBounds * sizeof(int));
+  const int64_t fileSize = newTreesOffset + nNewTrees * sizeof(int);
+  char *file;
+  int fd;
+
+  if (strlen(filename) + 5 > sizeof(tmpFilename)) {
+    return false;
+  }
+  memcpy(tmpFilename, filename, strlen(filename));
+  memcpy(tmpFilename + strlen(filename), ".tmp", 5);
+
+  fd = open(tmpFilename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  if (ftruncate(fd, fileSize) != 0) {
+    close(fd);
+    return false;
+  }
+  file = (char*)mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+      0);
+  close(fd);
+  if (file == MAP_FAILED) {
+    return false;
+  }
+
+  header = (struct CheckpointHeader*)file;
+  memcpy(header->magic, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_LENGTH);
+  header->nRows = NRows;
+  header->nCols = NCols;
+  header->burnProb = BurnProb;
+  header->nMaxBurnSteps = NMaxBurnSteps;
+  header->nSteps = NSteps;
+  header->randSeed = RandSeed;
+  header->isCounterRand = IsCounterRand;
+  header->engine = engine;
+  header->curStep = CurStep;
+  header->nBurnedTrees = NBurnedTrees;
+  header->nNewTrees = nNewTrees;
+  header->treesOffset = treesOffset;
+  header->newTreesOffset = newTreesOffset;
+  memcpy(header->randState, RandState, sizeof(header->randState));
+  memcpy(file + treesOffset, Trees, (size_t)NTreesPlusBounds * sizeof(int));
+  memcpy(file + newTreesOffset, NewTrees, nNewTrees * sizeof(int));
+
+  if (msync(file, fileSize, MS_SYNC) != 0 || munmap(file, fileSize) != 0) {
+    return false;
+  }
+  return rename(tmpFilename, filename) == 0;
+}
+
+/* Start writing a checkpoint of the current time step in the background.
+   Waits first if the previous checkpoint is still being written.
+
+   @param filename The checkpoint file
+   @param engine The selected engine
+   @param nNewTrees The number of ints in NewTrees
+   */
+void WriteCheckpoint(const char *filename, const int engine,
+    const int64_t nNewTrees) {
+  pid_t pid;
+
+  WaitForCheckpoint();
+
+  /* Have random() store its position in RandState */
+  setstate((char*)RandState);
+
+  /* Make sure buffered output is not written twice */
+  fflush(NULL);
+
+  pid = fork();
+  if (pid < 0) {
+    /* Could not fork; write it here instead */
+    if (!WriteCheckpointFile(filename, engine, nNewTrees)) {
+      fprintf(stderr, "WARNING: writing a checkpoint failed\n");
+    }
+    return;
+  }
+  if (pid == 0) {
+    /* The child has a snapshot of memory; write it and leave without
+       running the parent's exit handlers */
+    _exit(WriteCheckpointFile(filename, engine, nNewTrees) ?
+        EXIT_SUCCESS : EXIT_FAILURE);
+  }
+  WriterPid = pid;
+}
+
+/* Map a checkpoint file and restore the simulation from it: the parameters,
+   CurStep, NBurnedTrees and the state of random() are set, and Trees and
+   NewTrees point into the mapping. Exits if the file is not a valid
+   checkpoint, including one whose engine, size, parameters or offsets
+   would lead outside the file. Whether NewTrees is the size the engine
+   needs is up to the caller, which knows the engines.
+
+   @param filename The checkpoint file
+   @param nEngines The number of engines; valid engines are below it
+   @param engine Set to the engine the checkpoint was written with
+   @param nNewTrees Set to the number of ints in NewTrees
+   */
+void MapCheckpoint(const char *filename, const int nEngines, int *engine,
+    int64_t *nNewTrees) {
+  const struct CheckpointHeader *header;
+  struct stat fileStat;
+  int fd;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0 || fstat(fd, &fileStat) != 0) {
+    fprintf(stderr, "ERROR: could not open checkpoint '%s'\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  MappingSize = fileStat.st_size;
+  if (MappingSize < sizeof(struct CheckpointHeader)) {
+    fprintf(stderr, "ERROR: '%s' is not a checkpoint\n", filename);
+    exit(EXIT_FAILURE);
+  }
+
+  /* Private mapping: the simulation may change the trees, but the file
+     keeps the checkpoint */
+  Mapping = mmap(NULL, MappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+      0);
+  close(fd);
+  if (Mapping == MAP_FAILED) {
+    fprintf(stderr, "ERROR: could not map checkpoint '%s'\n", filename);
+    exit(EXIT_FAILURE);
+  }
+
+  header = (const struct CheckpointHeader*)Mapping;
+  if (memcmp(header->magic, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_LENGTH) != 0 ||
+      header->engine < 0 || header->engine >= nEngines ||
+      header->nRows <= 0 || header->nCols <= 0 ||
+      header->nMaxBurnSteps < 1 || header->nSteps < 0 ||
+      header->curStep < 0 || header->curStep > header->nSteps ||
+      !IsInMapping(header->treesOffset,
+        ((int64_t)header->nRows + 2 * NBounds) *
+        ((int64_t)header->nCols + 2 * NBounds)) ||
+      !IsInMapping(header->newTreesOffset, header->nNewTrees)) {
+    fprintf(stderr, "ERROR: '%s' is not a checkpoint\n", filename);
+    exit(EXIT_FAILURE);
+  }
+
+  NRows = header->nRows;
+  NCols = header->nCols;
+  BurnProb = header->burnProb;
+  NMaxBurnSteps = header->nMaxBurnSteps;
+  NSteps = header->nSteps;
+  RandSeed = header->randSeed;
+  IsCounterRand = header->isCounterRand;
+  *engine = header->engine;
+  *nNewTrees = header->nNewTrees;
+  CurStep = header->curStep;
+  NBurnedTrees = header->nBurnedTrees;
+  Trees = (int*)((char*)Mapping + header->treesOffset);
+  NewTrees = (int*)((char*)Mapping + header->newTreesOffset);
+
+  /* Put random() back where it was */
+  memcpy(RandState, header->randState, sizeof(header->randState));
+  setstate((char*)RandState);
+}
+
+/* Wait for the last checkpoint to be written and unmap the checkpoint the
+   run was restarted from, if any */
+void CloseCheckpoint() {
+  WaitForCheckpoint();
+  if (Mapping != NULL) {
+    munmap(Mapping, MappingSize);
+    Mapping = NULL;
+  }
+}
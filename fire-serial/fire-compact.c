@@ -0,0 +1,352 @@
+/* Compact tree storage for the forest fire model.
+
+   A tree's state only ranges over 0..NMaxBurnSteps, but Trees spends a
+   4-byte int on it. When NMaxBurnSteps is less than 256 these engines store
+   the forest more compactly:
+
+   compact   - one byte per tree (4 times smaller)
+   bitsliced - the state is split into bit planes, so with the default
+               NMaxBurnSteps of 2 a tree takes 2 bits (16 times smaller);
+               64 trees of a row are updated at once with bitwise operations
+
+   Both engines keep two identically padded forests and swap them after each
+   time step, like the fused engine. Trees are visited in row-major order, so
+   random() is called in the same order as in BurnNew() and the results match
+   the serial engine exactly.
+   */
+
+#include <stdint.h> /* uint8_t, uint64_t */
+#include <stdlib.h> /* exit() */
+#include "fire-serial.h"
+#include "fire-rng.h"
+
+/* Number of trees in one word of a bit plane */
+#define WORD_BITS 64
+
+static bool IsBitSliced; /* Bit planes rather than one byte per tree? */
+
+/* Byte storage: padded forest of NRowsPlusBounds x NColsPlusBounds */
+static uint8_t *Bytes;
+static uint8_t *NewBytes;
+
+/* Bit plane storage: each padded row holds NPlanes planes of NWords words,
+   and bit b of plane p of word w holds bit p of the state of the tree in
+   column w * WORD_BITS + b */
+static int NPlanes;
+static int NWords;
+static uint64_t *Planes;
+static uint64_t *NewPlanes;
+
+/* Return the first word of a bit plane of a row
+
+   @param planes The bit plane storage
+   @param row The row index of the trees
+   @param plane The bit plane
+   @return Pointer to the first word
+   */
+static uint64_t *PlaneRow(uint64_t *planes, const int row, const int plane) {
+  return &planes[((size_t)row * NPlanes + plane) * NWords];
+}
+
+/* Return the number of bytes in the bit plane storage
+
+   @return The number of bytes
+   */
+static size_t PlanesSize() {
+  return (size_t)NRowsPlusBounds * NPlanes * NWords * sizeof(uint64_t);
+}
+
+/* Store the state of one tree in bit planes
+
+   @param planes The bit plane storage
+   @param row The row index of the tree
+   @param col The column index of the tree
+   @param state The number of time steps the tree has burned
+   */
+static void SetPlaneState(uint64_t *planes, const int row, const int col,
+    const int state) {
+  const uint64_t bit = (uint64_t)1 << (col % WORD_BITS);
+  int plane;
+
+  for (plane = 0; plane < NPlanes; plane++) {
+    uint64_t *word = &PlaneRow(planes, row, plane)[col / WORD_BITS];
+
+    if ((state >> plane) & 1) {
+      *word |= bit;
+    }
+    else {
+      *word &= ~bit;
+    }
+  }
+}
+
+/* Set the state of one tree
+
+   @param row The row index of the tree
+   @param col The column index of the tree
+   @param state The number of time steps the tree has burned
+   */
+static void SetCompactState(const int row, const int col, const int state) {
+  if (IsBitSliced) {
+    SetPlaneState(Planes, row, col, state);
+    SetPlaneState(NewPlanes, row, col, state);
+  }
+  else {
+    Bytes[TREE_MAP(row, col, NColsPlusBounds)] =
+      NewBytes[TREE_MAP(row, col, NColsPlusBounds)] = state;
+  }
+}
+
+/* Allocate the compact forests with every tree unburned
+
+   @param isBitSliced Use bit planes rather than one byte per tree?
+   */
+void AllocateCompact(const bool isBitSliced) {
+  IsBitSliced = isBitSliced;
+
+  if (IsBitSliced) {
+    /* Enough planes to hold NMaxBurnSteps */
+    for (NPlanes = 1; (NMaxBurnSteps >> NPlanes) > 0; NPlanes++);
+    NWords = (NColsPlusBounds + WORD_BITS - 1) / WORD_BITS;
+    Planes = (uint64_t*)AllocateForest(PlanesSize());
+    NewPlanes = (uint64_t*)AllocateForest(PlanesSize());
+    if (Planes == NULL || NewPlanes == NULL) {
+      fprintf(stderr, "ERROR: out of memory for the bit planes\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  else {
+    Bytes = (uint8_t*)AllocateForest(NTreesPlusBounds * sizeof(uint8_t));
+    NewBytes = (uint8_t*)AllocateForest(NTreesPlusBounds * sizeof(uint8_t));
+    if (Bytes == NULL || NewBytes == NULL) {
+      fprintf(stderr, "ERROR: out of memory for the compact forest\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+/* Set the boundaries as burnt out and light the first tree on fire; all
+   other trees are already unburned
+
+   @param firstRow The row index of the first tree to light
+   @param firstCol The column index of the first tree to light
+   */
+void InitCompact(const int firstRow, const int firstCol) {
+  int row;
+  int col;
+
+  for (row = 0; row < NRowsPlusBounds; row++) {
+    /* Left */
+    SetCompactState(row, 0, NMaxBurnSteps);
+
+    /* Top/Bottom */
+    if ((row == 0) || (row == NRows + 1)) {
+      for (col = 1; col < NCols + 1; col++) {
+        SetCompactState(row, col, NMaxBurnSteps);
+      }
+    }
+
+    /* Right */
+    SetCompactState(row, NCols + 1, NMaxBurnSteps);
+  }
+
+  SetCompactState(firstRow, firstCol, 1);
+}
+
+/* Return the state of one tree
+
+   @param row The row index of the tree
+   @param col The column index of the tree
+   @return The number of time steps the tree has burned
+   */
+int CompactTreeState(const int row, const int col) {
+  int state = 0;
+  int plane;
+
+  if (!IsBitSliced) {
+    return Bytes[TREE_MAP(row, col, NColsPlusBounds)];
+  }
+
+  for (plane = 0; plane < NPlanes; plane++) {
+    state |= ((PlaneRow(Planes, row, plane)[col / WORD_BITS] >>
+          (col % WORD_BITS)) & 1) << plane;
+  }
+  return state;
+}
+
+/* Advance every byte-sized tree by one time step in a single sweep */
+static void StepBytes() {
+  const int nColsPlusBounds = NColsPlusBounds;
+  const int nMaxBurnSteps = NMaxBurnSteps;
+  const bool isCounterRand = IsCounterRand;
+  const uint64_t threshold = CounterThreshold(BurnProb);
+  uint8_t *swap;
+  int row;
+  int col;
+
+  for (row = 1; row < NRows + 1; row++) {
+    const uint8_t *above = &Bytes[TREE_MAP(row - 1, 0, nColsPlusBounds)];
+    const uint8_t *cur   = &Bytes[TREE_MAP(row,     0, nColsPlusBounds)];
+    const uint8_t *below = &Bytes[TREE_MAP(row + 1, 0, nColsPlusBounds)];
+    uint8_t *next        = &NewBytes[TREE_MAP(row,  0, nColsPlusBounds)];
+    const uint32_t rowKey = CounterRowKey(RandSeed, CurStep, row);
+
+    for (col = 1; col < NCols + 1; col++) {
+      const int state = cur[col];
+
+      if (IsStateOnFire(state, nMaxBurnSteps)) {
+        next[col] = state + 1;
+      }
+      else if (state == 0 &&
+          (IsStateOnFire(above[col],   nMaxBurnSteps) ||
+           IsStateOnFire(cur[col - 1], nMaxBurnSteps) ||
+           IsStateOnFire(below[col],   nMaxBurnSteps) ||
+           IsStateOnFire(cur[col + 1], nMaxBurnSteps)) &&
+          (isCounterRand ? CounterCatchesFire(rowKey, col, threshold) :
+                           CatchesFire(row, col))) {
+        next[col] = 1;
+        NBurnedTrees++;
+      }
+      else {
+        next[col] = state;
+      }
+    }
+  }
+
+  swap = Bytes;
+  Bytes = NewBytes;
+  NewBytes = swap;
+}
+
+/* Return a mask of the trees of one word that are not burning yet
+
+   @param planes The bit plane storage
+   @param row The row index of the trees
+   @param word The word index of the trees
+   @return Mask with a bit set for each tree with state 0
+   */
+static uint64_t UnburnedMask(uint64_t *planes, const int row,
+    const int word) {
+  uint64_t anyBit = 0;
+  int plane;
+
+  for (plane = 0; plane < NPlanes; plane++) {
+    anyBit |= PlaneRow(planes, row, plane)[word];
+  }
+  return ~anyBit;
+}
+
+/* Return a mask of the trees of one word that are on fire
+
+   @param planes The bit plane storage
+   @param row The row index of the trees
+   @param word The word index of the trees
+   @return Mask with a bit set for each tree with state in
+     [1..NMaxBurnSteps), or 0 if the word is outside the forest
+   */
+static uint64_t OnFireMask(uint64_t *planes, const int row,
+    const int word) {
+  uint64_t isBurntOut = ~(uint64_t)0;
+  int plane;
+
+  if (word < 0 || word >= NWords) {
+    return 0;
+  }
+
+  /* States never pass NMaxBurnSteps, so burnt out means equal to it */
+  for (plane = 0; plane < NPlanes; plane++) {
+    const uint64_t bits = PlaneRow(planes, row, plane)[word];
+
+    isBurntOut &= ((NMaxBurnSteps >> plane) & 1) ? bits : ~bits;
+  }
+  return ~UnburnedMask(planes, row, word) & ~isBurntOut;
+}
+
+/* Return a mask of the trees of one word that are inside the boundaries
+
+   @param word The word index of the trees
+   @return Mask with a bit set for each column in [1..NCols]
+   */
+static uint64_t InteriorMask(const int word) {
+  const int firstCol = word * WORD_BITS;
+  const int lowBit = firstCol < 1 ? 1 - firstCol : 0;
+  const int highBit = NCols - firstCol;
+
+  if (highBit < lowBit) {
+    return 0;
+  }
+  return (highBit >= WORD_BITS - 1 ? ~(uint64_t)0 :
+      ((uint64_t)1 << (highBit + 1)) - 1) & (~(uint64_t)0 << lowBit);
+}
+
+/* Advance every bit-sliced tree by one time step, 64 trees at a time */
+static void StepBitSliced() {
+  const uint64_t threshold = CounterThreshold(BurnProb);
+  uint64_t *swap;
+  int row;
+  int word;
+  int plane;
+
+  for (row = 1; row < NRows + 1; row++) {
+    const uint32_t rowKey = CounterRowKey(RandSeed, CurStep, row);
+
+    for (word = 0; word < NWords; word++) {
+      const uint64_t interior = InteriorMask(word);
+      const uint64_t onFire = OnFireMask(Planes, row, word);
+      /* Trees with a burning neighbor to the top, left, bottom or right */
+      const uint64_t nearFire = OnFireMask(Planes, row - 1, word) |
+        (onFire << 1) | (OnFireMask(Planes, row, word - 1) >> 63) |
+        OnFireMask(Planes, row + 1, word) |
+        (onFire >> 1) | (OnFireMask(Planes, row, word + 1) << 63);
+      uint64_t candidates = UnburnedMask(Planes, row, word) & nearFire &
+        interior;
+      uint64_t ignite = 0;
+      uint64_t carry = onFire & interior;
+
+      /* Apply random chance to each candidate in column order */
+      while (candidates != 0) {
+        const int bit = __builtin_ctzll(candidates);
+        const int col = word * WORD_BITS + bit;
+
+        if (IsCounterRand ? CounterCatchesFire(rowKey, col, threshold) :
+                            CatchesFire(row, col)) {
+          ignite |= (uint64_t)1 << bit;
+          NBurnedTrees++;
+        }
+        candidates &= candidates - 1;
+      }
+
+      /* Add 1 to the burning trees and set the ignited trees (which are 0)
+         to 1 */
+      for (plane = 0; plane < NPlanes; plane++) {
+        const uint64_t bits = PlaneRow(Planes, row, plane)[word];
+
+        PlaneRow(NewPlanes, row, plane)[word] =
+          (bits ^ carry) | (plane == 0 ? ignite : 0);
+        carry &= bits;
+      }
+    }
+  }
+
+  swap = Planes;
+  Planes = NewPlanes;
+  NewPlanes = swap;
+}
+
+/* Advance every tree by one time step */
+void StepCompact() {
+  if (IsBitSliced) {
+    StepBitSliced();
+  }
+  else {
+    StepBytes();
+  }
+}
+
+/* Free the compact forests */
+void FreeCompact() {
+  FreeForest(Bytes, NTreesPlusBounds * sizeof(uint8_t));
+  FreeForest(NewBytes, NTreesPlusBounds * sizeof(uint8_t));
+  FreeForest(Planes, PlanesSize());
+  FreeForest(NewPlanes, PlanesSize());
+}
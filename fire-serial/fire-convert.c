@@ -0,0 +1,174 @@
+/* Convert the binary output of the forest fire model (fire-serial -o FILE -B)
+   into the same text that fire-serial -o FILE writes without -B.
+
+   Usage: fire-convert BINARY_FILE TEXT_FILE
+   */
+
+#include <stdbool.h> /* bool type */
+#include <stdint.h> /* SIZE_MAX */
+#include <stdio.h> /* fopen(), fread(), fprintf() */
+#include <stdlib.h> /* malloc(), free(), exit(), EXIT_FAILURE */
+#include <string.h> /* memcmp() */
+#include <unistd.h> /* access() */
+#include "fire-output.h"
+
+/* Define the widest state the text format pads to */
+#define MAX_STATE_DIGITS 10
+
+/* A frame being converted, for GetCellState() */
+struct Frame {
+  const void *cells;
+  int nCols;
+  int cellBytes;
+};
+
+/* Print an error message and exit the program in failure
+
+   @param errorMsg The error message to print
+   */
+void Fail(const char *errorMsg) {
+  fprintf(stderr, "ERROR: %s\n", errorMsg);
+  exit(EXIT_FAILURE);
+}
+
+/* Read bytes from the binary file, exiting on failure
+
+   @param data Where to put the bytes
+   @param size The number of bytes
+   @param file The binary file
+   */
+void ReadBytes(void *data, const size_t size, FILE *file) {
+  if (size > 0 && fread(data, size, 1, file) != 1) {
+    Fail("binary file is truncated");
+  }
+}
+
+/* Allocate memory, exiting on failure
+
+   @param size The number of bytes
+   @return The memory
+   */
+void *Allocate(const size_t size) {
+  void *memory = malloc(size > 0 ? size : 1);
+
+  if (memory == NULL) {
+    Fail("out of memory");
+  }
+  return memory;
+}
+
+/* Return the state of a tree of a frame for WriteTextFrame()
+
+   @param row The row index of the tree, from 0
+   @param col The column index of the tree, from 0
+   @param context The struct Frame
+   @return The tree state
+   */
+int GetCellState(int row, int col, const void *context) {
+  const struct Frame *frame = (const struct Frame*)context;
+
+  return GetFrameCell(frame->cells, (int64_t)row * frame->nCols + col,
+      frame->cellBytes);
+}
+
+/* @param argc The number of command line arguments
+   @param argv String of command line arguments
+   */
+int main(int argc, char **argv) {
+  struct FrameFileHeader fileHeader;
+  struct FrameHeader header;
+  FILE *binaryFile;
+  FILE *textFile;
+  struct Frame frame;
+  bool hasFullFrame = false; /* Has a full frame been read yet? */
+  void *cells; /* The state of every tree in the current frame */
+  int64_t *indices; /* Trees listed in a delta frame */
+  void *deltaCells; /* Their states */
+  int64_t nTrees;
+  int64_t i;
+
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s BINARY_FILE TEXT_FILE\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  binaryFile = fopen(argv[1], "rb");
+  if (binaryFile == NULL) {
+    Fail("could not open binary file");
+  }
+  ReadBytes(&fileHeader, sizeof(fileHeader), binaryFile);
+  if (memcmp(fileHeader.magic, FRAME_FILE_MAGIC,
+        FRAME_FILE_MAGIC_LENGTH) != 0) {
+    Fail("not a fire-serial binary output file");
+  }
+  if (fileHeader.nRows <= 0 || fileHeader.nCols <= 0 ||
+      (fileHeader.cellBytes != 1 && fileHeader.cellBytes != 2 &&
+       fileHeader.cellBytes != 4) ||
+      fileHeader.stateDigits < 0 ||
+      fileHeader.stateDigits > MAX_STATE_DIGITS) {
+    Fail("binary file is corrupt");
+  }
+
+  /* Match fire-serial -o, which refuses to overwrite files */
+  if (access(argv[2], F_OK) != -1) {
+    Fail("text file already exists");
+  }
+  textFile = fopen(argv[2], "w");
+  if (textFile == NULL) {
+    Fail("could not open text file");
+  }
+
+  nTrees = (int64_t)fileHeader.nRows * fileHeader.nCols;
+  if ((uint64_t)nTrees > SIZE_MAX / sizeof(int64_t)) {
+    Fail("binary file has too many trees");
+  }
+  cells = Allocate(nTrees * fileHeader.cellBytes);
+  indices = (int64_t*)Allocate(nTrees * sizeof(int64_t));
+  deltaCells = Allocate(nTrees * fileHeader.cellBytes);
+
+  frame.cells = cells;
+  frame.nCols = fileHeader.nCols;
+  frame.cellBytes = fileHeader.cellBytes;
+
+  while (fread(&header, sizeof(header), 1, binaryFile) == 1) {
+    if (header.nCells < 0 || header.nCells > nTrees) {
+      Fail("binary file is corrupt");
+    }
+
+    if (header.kind == FRAME_FULL) {
+      if (header.nCells != nTrees) {
+        Fail("binary file is corrupt");
+      }
+      ReadBytes(cells, nTrees * fileHeader.cellBytes, binaryFile);
+      hasFullFrame = true;
+    }
+    else if (header.kind == FRAME_DELTA && hasFullFrame) {
+      /* Apply the changes to the previous frame */
+      ReadBytes(indices, header.nCells * sizeof(int64_t), binaryFile);
+      ReadBytes(deltaCells, header.nCells * fileHeader.cellBytes,
+          binaryFile);
+      for (i = 0; i < header.nCells; i++) {
+        if (indices[i] < 0 || indices[i] >= nTrees) {
+          Fail("binary file is corrupt");
+        }
+        SetFrameCell(cells, indices[i], fileHeader.cellBytes,
+            GetFrameCell(deltaCells, i, fileHeader.cellBytes));
+      }
+    }
+    else {
+      /* An unknown kind, or changes to no frame */
+      Fail("binary file is corrupt");
+    }
+
+    /* Write the frame the way OutputData() does */
+    WriteTextFrame(textFile, header.step, fileHeader.nRows, fileHeader.nCols,
+        fileHeader.stateDigits, GetCellState, &frame);
+  }
+
+  free(deltaCells);
+  free(indices);
+  free(cells);
+  fclose(textFile);
+  fclose(binaryFile);
+  return 0;
+}
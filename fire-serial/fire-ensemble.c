@@ -0,0 +1,167 @@
+/* Ensemble mode for the forest fire model.
+
+   Instead of one simulation, run one for every combination of a range of
+   burn probabilities and a range of seeds, spread across OpenMP threads, and
+   print the mean and standard deviation of the percentage of trees burned
+   for each burn probability.
+
+   The forest size, NMaxBurnSteps and NSteps are shared by every run and
+   stay in the usual globals. Everything that differs between runs lives in
+   a struct ForestRun, one per thread, whose forests are allocated once and
+   reused for every run that thread does, and each run is advanced by
+   StepForestRun(), the sweep of the fused engine. Catching fire and a -f
+   first tree use the counter-based generator in fire-rng.h keyed on each
+   run's seed, so a run matches fire-serial -k with the same -b and -s.
+
+   Under fire-mpi the runs are also dealt out among the ranks, every
+   nRanks-th run to each, and rank 0 collects the results and prints them.
+   */
+
+#include <math.h> /* sqrt() */
+#include <stdlib.h> /* malloc(), calloc(), free(), exit() */
+#include <string.h> /* memset(), memcpy() */
+#include "fire-serial.h"
+#include "fire-rng.h"
+#ifdef FIRE_MPI
+#include <mpi.h> /* MPI_Comm_size(), MPI_Reduce() */
+#endif
+
+/* Start a run: every tree unburned, the boundaries burnt out and the first
+   tree on fire
+
+   @param run The run, with its forests already allocated
+   @param burnProb Chance of catching fire, [0..100]
+   @param randSeed Seed for the counter-based generator
+   @param isRandFirstTree Light a random tree instead of the middle one?
+   */
+static void InitRun(struct ForestRun *run, const int burnProb,
+    const int randSeed, const bool isRandFirstTree) {
+  int row;
+  int col;
+
+  run->isCounterRand = true;
+  run->randSeed = randSeed;
+  run->threshold = CounterThreshold(burnProb);
+  run->curStep = 0;
+
+  memset(run->trees, 0, NTreesPlusBounds * sizeof(int));
+  for (row = 0; row < NRowsPlusBounds; row++) {
+    for (col = 0; col < NColsPlusBounds; col++) {
+      if (row == 0 || row == NRows + 1 || col == 0 || col == NCols + 1) {
+        run->trees[TREE_MAP(row, col, NColsPlusBounds)] = NMaxBurnSteps;
+      }
+    }
+  }
+
+  if (isRandFirstTree) {
+    /* Draw the first tree from the run's own seed */
+    CounterFirstTree(randSeed, NRows, NCols, &row, &col);
+  }
+  else {
+    row = NRows / 2 + 1;
+    col = NCols / 2 + 1;
+  }
+  run->trees[TREE_MAP(row, col, NColsPlusBounds)] = 1;
+  run->nBurnedTrees = 1;
+
+  memcpy(run->newTrees, run->trees, NTreesPlusBounds * sizeof(int));
+}
+
+/* Run every combination of burn probability and seed, and print the mean
+   and standard deviation of the percentage of trees burned for each burn
+   probability
+
+   @param lowProb The first burn probability
+   @param highProb The last burn probability
+   @param probStep The difference between consecutive burn probabilities
+   @param firstSeed The first seed
+   @param nSeeds The number of seeds per burn probability
+   @param isRandFirstTree Light a random tree instead of the middle one?
+   */
+void RunEnsemble(const int lowProb, const int highProb, const int probStep,
+    const int firstSeed, const int nSeeds, const bool isRandFirstTree) {
+  const int nProbs = (highProb - lowProb) / probStep + 1;
+  const int nRuns = nProbs * nSeeds;
+  double *percentBurned; /* Result of each run, by probability then seed */
+  int nRanks = 1; /* Number of MPI ranks sharing the runs */
+  int i;
+
+#ifdef FIRE_MPI
+  MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+#endif
+
+  /* Runs of other ranks stay 0 */
+  percentBurned = (double*)calloc(nRuns, sizeof(double));
+  if (percentBurned == NULL) {
+    fprintf(stderr, "ERROR: out of memory for the ensemble results\n");
+    exit(EXIT_FAILURE);
+  }
+
+#pragma omp parallel
+  {
+    struct ForestRun run;
+    int runIndex;
+
+    /* Allocate this thread's forests once for all of its runs */
+    run.trees = (int*)malloc(NTreesPlusBounds * sizeof(int));
+    run.newTrees = (int*)malloc(NTreesPlusBounds * sizeof(int));
+    if (run.trees == NULL || run.newTrees == NULL) {
+      fprintf(stderr, "ERROR: out of memory for an ensemble run\n");
+      exit(EXIT_FAILURE);
+    }
+
+#pragma omp for schedule(dynamic)
+    for (runIndex = Rank; runIndex < nRuns; runIndex += nRanks) {
+      struct ForestStats stats; /* Of the forest before the last step */
+
+      InitRun(&run, lowProb + (runIndex / nSeeds) * probStep,
+          firstSeed + runIndex % nSeeds, isRandFirstTree);
+
+      /* Stop early once a time step starts with no tree burning, since it
+         and every later one leave the forest as it is */
+      do {
+        ClearStats(&stats);
+        StepForestRun(&run, &stats);
+      } while (run.curStep < NSteps && stats.nBurning > 0);
+      percentBurned[runIndex] = (100.0 * run.nBurnedTrees) / NTrees;
+    }
+
+    free(run.trees);
+    free(run.newTrees);
+  }
+
+#ifdef FIRE_MPI
+  /* Each run was done by one rank, so the sum is its result */
+  MPI_Reduce(Rank == 0 ? MPI_IN_PLACE : percentBurned, percentBurned, nRuns,
+      MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+#endif
+  if (Rank != 0) {
+    free(percentBurned);
+    return;
+  }
+
+  printf("# %d x %d forest, %d time steps, %d seeds from %d\n", NRows,
+      NCols, NSteps, nSeeds, firstSeed);
+  printf("# burn_prob  mean_burned_pct  stddev_burned_pct\n");
+  for (i = 0; i < nProbs; i++) {
+    const double *results = &percentBurned[i * nSeeds];
+    double mean = 0.0;
+    double variance = 0.0;
+    int seed;
+
+    for (seed = 0; seed < nSeeds; seed++) {
+      mean += results[seed];
+    }
+    mean /= nSeeds;
+    for (seed = 0; seed < nSeeds; seed++) {
+      variance += (results[seed] - mean) * (results[seed] - mean);
+    }
+    /* Sample standard deviation; 0 for a single seed */
+    variance = nSeeds > 1 ? variance / (nSeeds - 1) : 0.0;
+
+    printf("%11d  %15.2f  %17.2f\n", lowProb + i * probStep, mean,
+        sqrt(variance));
+  }
+
+  free(percentBurned);
+}
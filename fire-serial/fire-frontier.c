@@ -0,0 +1,138 @@
+/* Frontier engine for the forest fire model.
+
+   Only burning trees and the unburned trees next to them can change during a
+   time step, so instead of scanning the whole forest this engine keeps a
+   worklist of the burning trees and only visits them and their neighbors.
+   The cost of a time step grows with the perimeter of the fire rather than
+   the area of the forest.
+
+   Trees that may catch fire are visited in row-major order, the same order
+   BurnNew() uses, so random() is called for the same trees in the same
+   order and the result matches the serial engine exactly.
+   */
+
+#include <stdlib.h> /* malloc(), realloc(), free(), qsort(), exit() */
+#include "fire-serial.h"
+
+/* Worklist of trees, stored as indices into Trees */
+struct TreeList {
+  int64_t *indices;
+  int64_t nIndices;
+  int64_t capacity;
+};
+
+static struct TreeList Burning; /* Trees that are on fire */
+static struct TreeList Candidates; /* Unburned trees next to a burning tree */
+static struct TreeList NextBurning; /* Trees on fire in the next time step */
+
+/* Add a tree to a worklist, growing the list if it is full
+
+   @param list The worklist
+   @param index The index of the tree in Trees
+   */
+static void PushTree(struct TreeList *list, const int64_t index) {
+  if (list->nIndices == list->capacity) {
+    list->capacity = list->capacity ? 2 * list->capacity : 1024;
+    list->indices = (int64_t*)realloc(list->indices,
+        list->capacity * sizeof(int64_t));
+    if (list->indices == NULL) {
+      fprintf(stderr, "ERROR: out of memory for the frontier worklist\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  list->indices[list->nIndices++] = index;
+}
+
+/* Order tree indices from smallest to largest, for qsort() */
+static int CompareIndices(const void *a, const void *b) {
+  const int64_t indexA = *(const int64_t*)a;
+  const int64_t indexB = *(const int64_t*)b;
+
+  return (indexA > indexB) - (indexA < indexB);
+}
+
+/* Fill the worklist with the trees that are already on fire */
+void InitFrontier() {
+  int row;
+  int col;
+
+  Burning.nIndices = 0;
+  for (row = 1; row < NRows + 1; row++) {
+    for (col = 1; col < NCols + 1; col++) {
+      const int64_t index = TREE_MAP(row, col, NColsPlusBounds);
+
+      if (IsStateOnFire(Trees[index], NMaxBurnSteps)) {
+        PushTree(&Burning, index);
+      }
+    }
+  }
+}
+
+/* Return whether any tree is still on fire */
+bool IsFrontierBurning() {
+  return Burning.nIndices > 0;
+}
+
+/* Advance the trees on the worklist by one time step, updating Trees in
+   place */
+void StepFrontier() {
+  const int64_t offsets[4] = { /* Top, Left, Bottom, Right */
+    -NColsPlusBounds, -1, NColsPlusBounds, 1
+  };
+  struct TreeList swap;
+  int64_t i;
+  int j;
+
+  /* Find the unburned neighbors of burning trees, each one only once and in
+     row-major order */
+  Candidates.nIndices = 0;
+  for (i = 0; i < Burning.nIndices; i++) {
+    for (j = 0; j < 4; j++) {
+      const int64_t neighbor = Burning.indices[i] + offsets[j];
+
+      if (Trees[neighbor] == 0) {
+        PushTree(&Candidates, neighbor);
+      }
+    }
+  }
+  qsort(Candidates.indices, Candidates.nIndices, sizeof(int64_t),
+      CompareIndices);
+
+  /* For trees already burning, increment the number of time steps they have
+     burned */
+  NextBurning.nIndices = 0;
+  for (i = 0; i < Burning.nIndices; i++) {
+    const int64_t index = Burning.indices[i];
+
+    if (IsStateOnFire(++Trees[index], NMaxBurnSteps)) {
+      PushTree(&NextBurning, index);
+    }
+  }
+
+  /* Try to catch the candidates on fire */
+  for (i = 0; i < Candidates.nIndices; i++) {
+    const int64_t index = Candidates.indices[i];
+
+    if (i > 0 && index == Candidates.indices[i - 1]) {
+      /* Next to more than one burning tree; already tried */
+      continue;
+    }
+
+    if (CatchesFire(index / NColsPlusBounds, index % NColsPlusBounds)) {
+      Trees[index] = 1;
+      PushTree(&NextBurning, index);
+      NBurnedTrees++;
+    }
+  }
+
+  swap = Burning;
+  Burning = NextBurning;
+  NextBurning = swap;
+}
+
+/* Free the worklists */
+void FreeFrontier() {
+  free(Burning.indices);
+  free(Candidates.indices);
+  free(NextBurning.indices);
+}
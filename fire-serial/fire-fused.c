@@ -0,0 +1,95 @@
+/* Fused engine for the forest fire model.
+
+   ContinueBurning(), BurnNew() and AdvanceTime() each sweep the whole forest,
+   and AdvanceTime() only copies NewTrees back into Trees. This engine does
+   all three in one sweep: it reads each tree of Trees once and writes its
+   next state into NewTrees, which has the same boundary as Trees, and then
+   swaps the two pointers instead of copying.
+
+   Trees are visited in row-major order, so random() is called in the same
+   order as in BurnNew() and the result matches the serial engine exactly.
+
+   The sweep itself, StepForestRun(), works on a struct ForestRun rather
+   than on the globals, so the ensemble runs the same code on its own
+   forests.
+   */
+
+#include <string.h> /* memcpy() */
+#include "fire-serial.h"
+#include "fire-kernel.h"
+
+/* Give NewTrees the same boundary as Trees; NewTrees must have room for
+   NTreesPlusBounds trees */
+void InitFused() {
+  const int64_t shift = BOUNDS_SHIFT(NBounds, NColsPlusBounds);
+
+  memcpy(NewTrees - shift, Trees - shift, NTreesPlusBounds * sizeof(int));
+}
+
+/* Advance every tree of a run by one time step in a single sweep, then swap
+   its two forests
+
+   @param run The run
+   @param stats Statistics to add the forest before the time step to, or
+     NULL
+   */
+void StepForestRun(struct ForestRun *run, struct ForestStats *stats) {
+  const int nRows = NRows;
+  const int nCols = NCols;
+  const int nColsPlusBounds = NColsPlusBounds;
+  const int nMaxBurnSteps = NMaxBurnSteps;
+  int64_t nBurnedTrees = 0;
+  int *swap;
+  int row;
+
+  for (row = 1; row < nRows + 1; row++) {
+    /* Rows of the current forest above, at and below this row, and the same
+       row of the next forest */
+    const int *above = &run->trees[TREE_MAP(row - 1, 0, nColsPlusBounds)];
+    const int *cur   = &run->trees[TREE_MAP(row,     0, nColsPlusBounds)];
+    const int *below = &run->trees[TREE_MAP(row + 1, 0, nColsPlusBounds)];
+    int *next        = &run->newTrees[TREE_MAP(row,  0, nColsPlusBounds)];
+    const uint32_t rowKey = CounterRowKey(run->randSeed, run->curStep, row);
+
+    if (stats != NULL) {
+      nBurnedTrees += StepRowFour(above, cur, below, next, 1, nCols,
+          nMaxBurnSteps, run->isCounterRand, rowKey, run->threshold, row, 0,
+          stats);
+    }
+    else {
+      nBurnedTrees += StepRowFour(above, cur, below, next, 1, nCols,
+          nMaxBurnSteps, run->isCounterRand, rowKey, run->threshold, row, 0,
+          NULL);
+    }
+  }
+
+  run->nBurnedTrees += nBurnedTrees;
+  run->curStep++;
+  swap = run->trees;
+  run->trees = run->newTrees;
+  run->newTrees = swap;
+}
+
+/* Advance every tree by one time step in a single sweep, then swap Trees and
+   NewTrees
+
+   @param stats Statistics to add the forest before the time step to, or
+     NULL
+   */
+void StepFused(struct ForestStats *stats) {
+  struct ForestRun run;
+
+  run.trees = Trees;
+  run.newTrees = NewTrees;
+  run.isCounterRand = IsCounterRand;
+  run.randSeed = RandSeed;
+  run.threshold = CounterThreshold(BurnProb);
+  run.curStep = CurStep;
+  run.nBurnedTrees = NBurnedTrees;
+
+  StepForestRun(&run, stats);
+
+  Trees = run.trees;
+  NewTrees = run.newTrees;
+  NBurnedTrees = run.nBurnedTrees;
+}
@@ -0,0 +1,119 @@
+/* The time step of one row of a padded forest with the 4 nearest trees as
+   the neighborhood, shared by every engine that keeps whole rows of trees
+   next to each other: fused, ensemble, tiled, simd (for the columns left
+   after the last full vector) and mpi.
+
+   A tree on fire burns one time step longer, an unburned tree next to a
+   burning tree may catch fire, and every other tree stays as it is. When
+   asked, the same sweep adds up the statistics of the forest before the
+   time step (see fire-stats.c), so -S needs no extra pass.
+   */
+
+#ifndef FIRE_KERNEL_H
+#define FIRE_KERNEL_H
+
+#include "fire-serial.h"
+#include "fire-rng.h"
+
+/* Advance columns firstCol up to lastCol of one row by one time step
+
+   The function is inline so that each call with stats NULL compiles to the
+   plain loop.
+
+   @param above The row above, indexed by column
+   @param cur The row itself
+   @param below The row below
+   @param next Set to the next state of the row
+   @param firstCol The first column to advance
+   @param lastCol The last column to advance
+   @param nMaxBurnSteps A tree stops burning after this many time steps
+   @param isCounterRand Draw with CounterCatchesFire() rather than
+     CatchesFire()?
+   @param rowKey The key of the row for CounterCatchesFire()
+   @param threshold CounterThreshold() of the burn probability
+   @param row The row index in the whole forest
+   @param colOffset The column index in the whole forest of column 0
+   @param stats Statistics to add the trees of the row to, or NULL
+   @return The number of trees that caught fire
+   */
+static inline int StepRowFour(const int *above, const int *cur,
+    const int *below, int *next, const int firstCol, const int lastCol,
+    const int nMaxBurnSteps, const bool isCounterRand, const uint32_t rowKey,
+    const uint64_t threshold, const int row, const int colOffset,
+    struct ForestStats *stats) {
+  int64_t nBurning = 0;
+  int64_t nBurntOut = 0;
+  int64_t perimeter = 0;
+  int minCol = lastCol + 1; /* Burning or burnt out columns of the row */
+  int maxCol = firstCol - 1;
+  int nIgnited = 0;
+  int col;
+
+  for (col = firstCol; col <= lastCol; col++) {
+    const int state = cur[col];
+
+    if (IsStateOnFire(state, nMaxBurnSteps)) {
+      /* Keep burning */
+      next[col] = state + 1;
+      if (stats != NULL) {
+        nBurning++;
+        minCol = col < minCol ? col : minCol;
+        maxCol = col;
+      }
+    }
+    else if (state == 0) {
+      int nBurningNeighbors;
+
+      if (stats != NULL) {
+        /* Each burning neighbor is an edge of the fire front */
+        nBurningNeighbors =
+          IsStateOnFire(above[col],   nMaxBurnSteps) +
+          IsStateOnFire(cur[col - 1], nMaxBurnSteps) +
+          IsStateOnFire(below[col],   nMaxBurnSteps) +
+          IsStateOnFire(cur[col + 1], nMaxBurnSteps);
+        perimeter += nBurningNeighbors;
+      }
+      else {
+        nBurningNeighbors =
+          IsStateOnFire(above[col],   nMaxBurnSteps) ||
+          IsStateOnFire(cur[col - 1], nMaxBurnSteps) ||
+          IsStateOnFire(below[col],   nMaxBurnSteps) ||
+          IsStateOnFire(cur[col + 1], nMaxBurnSteps);
+      }
+
+      if (nBurningNeighbors > 0 &&
+          (isCounterRand ?
+           CounterCatchesFire(rowKey, colOffset + col, threshold) :
+           CatchesFire(row, colOffset + col))) {
+        /* Catch the tree on fire */
+        next[col] = 1;
+        nIgnited++;
+      }
+      else {
+        next[col] = 0;
+      }
+    }
+    else {
+      /* Burnt out; nothing changes */
+      next[col] = state;
+      if (stats != NULL) {
+        nBurntOut++;
+        minCol = col < minCol ? col : minCol;
+        maxCol = col;
+      }
+    }
+  }
+
+  if (stats != NULL) {
+    stats->nBurning += nBurning;
+    stats->nBurntOut += nBurntOut;
+    stats->perimeter += perimeter;
+    if (maxCol >= minCol) {
+      AddToBoundingBox(stats, row, colOffset + minCol);
+      AddToBoundingBox(stats, row, colOffset + maxCol);
+    }
+  }
+  return nIgnited;
+}
+
+#endif
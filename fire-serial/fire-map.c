@@ -0,0 +1,285 @@
+/* Terrain maps for the forest fire model.
+
+   Without a map every tree is the same: it catches fire with chance
+   BurnProb and burns for NMaxBurnSteps - 1 time steps. With -M each tree
+   gets its own values from a binary raster file:
+
+   burn probability - the percent chance the tree catches fire when a
+                      neighbor is burning
+   burn steps       - its fuel: the tree stops burning once it has burned
+                      this many time steps, at most the header's max burn
+                      steps
+   wind direction   - where the wind at the tree comes from: 0 for calm,
+                      then 1, 2, 3 or 4 for north, east, south or west
+   wind bias        - percent added to the burn probability when the
+                      neighbor the wind comes from is burning
+
+   The file is a RasterHeader followed by one plane per value, each
+   NRows * NCols bytes in row-major order:
+
+   "FIREMAP1" | int32 rows | int32 cols | int32 max burn steps | int32 0 |
+   burn probabilities | burn steps | wind directions | wind biases
+
+   The file is mapped into memory read-only, so nothing is parsed or copied;
+   pages are loaded as the first time step touches them. Each plane is an
+   array of bytes laid out like NewTrees, so the kernels read one extra byte
+   per tree per value, in the same order as Trees.
+
+   A tree that runs out of fuel jumps straight to NMaxBurnSteps, so every
+   other part of the program (output, statistics) still sees a burnt out
+   tree as one with at least NMaxBurnSteps.
+
+   A map with the same values everywhere, no wind, and -b and -m as its
+   values gives exactly the same result as running without it.
+   */
+
+#include <fcntl.h> /* open() */
+#include <stdlib.h> /* exit() */
+#include <string.h> /* memcmp() */
+#include <sys/mman.h> /* mmap(), munmap() */
+#include <sys/stat.h> /* fstat() */
+#include <unistd.h> /* close() */
+#include "fire-serial.h"
+#include "fire-rng.h"
+
+/* Define the characters at the start of every map file */
+#define RASTER_MAGIC "FIREMAP1"
+#define RASTER_MAGIC_LENGTH 8
+
+/* Define the number of planes in a map file */
+#define N_RASTER_PLANES 4
+
+/* Define where the wind at a tree comes from */
+enum WindDir {
+  WIND_CALM,
+  WIND_FROM_NORTH,
+  WIND_FROM_EAST,
+  WIND_FROM_SOUTH,
+  WIND_FROM_WEST
+};
+
+struct RasterHeader {
+  char magic[RASTER_MAGIC_LENGTH];
+  int32_t nRows;
+  int32_t nCols;
+  int32_t nMaxBurnSteps; /* No tree burns longer than this */
+  int32_t reserved; /* 0 */
+};
+
+static void *Mapping = NULL; /* Map file mapped by MapRaster() */
+static size_t MappingSize;
+
+/* The planes of the map, indexed like NewTrees without a boundary */
+static const uint8_t *CellBurnProbs;
+static const uint8_t *CellBurnSteps;
+static const uint8_t *CellWindDirs;
+static const uint8_t *CellWindBiases;
+
+/* Map a map file and point the planes into it; NRows, NCols and
+   NMaxBurnSteps are set from its header. Exits if the file is not a valid
+   map.
+
+   @param filename The map file
+   */
+void MapRaster(const char *filename) {
+  const struct RasterHeader *header;
+  struct stat fileStat;
+  int64_t nTrees;
+  int fd;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0 || fstat(fd, &fileStat) != 0) {
+    fprintf(stderr, "ERROR: could not open map '%s'\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  MappingSize = fileStat.st_size;
+  if (MappingSize < sizeof(struct RasterHeader)) {
+    fprintf(stderr, "ERROR: '%s' is not a map\n", filename);
+    exit(EXIT_FAILURE);
+  }
+
+  Mapping = mmap(NULL, MappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (Mapping == MAP_FAILED) {
+    fprintf(stderr, "ERROR: could not map '%s'\n", filename);
+    exit(EXIT_FAILURE);
+  }
+
+  header = (const struct RasterHeader*)Mapping;
+  nTrees = (int64_t)header->nRows * header->nCols;
+  if (memcmp(header->magic, RASTER_MAGIC, RASTER_MAGIC_LENGTH) != 0 ||
+      header->nRows < 1 || header->nCols < 1 || header->nMaxBurnSteps < 2 ||
+      (int64_t)sizeof(struct RasterHeader) + N_RASTER_PLANES * nTrees >
+      (int64_t)MappingSize) {
+    fprintf(stderr, "ERROR: '%s' is not a map\n", filename);
+    exit(EXIT_FAILURE);
+  }
+
+  NRows = header->nRows;
+  NCols = header->nCols;
+  NMaxBurnSteps = header->nMaxBurnSteps;
+  CellBurnProbs = (const uint8_t*)(header + 1);
+  CellBurnSteps = CellBurnProbs + nTrees;
+  CellWindDirs = CellBurnSteps + nTrees;
+  CellWindBiases = CellWindDirs + nTrees;
+}
+
+/* Return the state of a burning tree after one more time step
+
+   @param state The number of time steps the tree has burned
+   @param burnSteps The tree stops burning after this many time steps
+   @param nMaxBurnSteps The state of every burnt out tree
+   @return The new state, NMaxBurnSteps once the tree is burnt out
+   */
+static inline int ContinueBurningTree(const int state, const int burnSteps,
+    const int nMaxBurnSteps) {
+  return state + 1 >= burnSteps ? nMaxBurnSteps : state + 1;
+}
+
+/* Return the percent chance that a tree catches fire, given which of its
+   neighbors are burning
+
+   @param index The index of the tree in the planes
+   @param top Is the neighbor to the north burning?
+   @param left Is the neighbor to the west burning?
+   @param bottom Is the neighbor to the south burning?
+   @param right Is the neighbor to the east burning?
+   @return The chance; more than 100 always catches
+   */
+static inline int CellChance(const int64_t index, const bool top,
+    const bool left, const bool bottom, const bool right) {
+  const int windDir = CellWindDirs[index];
+  const bool isUpwindOnFire =
+    (windDir == WIND_FROM_NORTH && top) ||
+    (windDir == WIND_FROM_EAST && right) ||
+    (windDir == WIND_FROM_SOUTH && bottom) ||
+    (windDir == WIND_FROM_WEST && left);
+
+  return CellBurnProbs[index] + (isUpwindOnFire ? CellWindBiases[index] : 0);
+}
+
+/* ContinueBurning() with the fuel of each tree from the map */
+void ContinueBurningMap() {
+  const int nMaxBurnSteps = NMaxBurnSteps;
+  int row;
+  int col;
+
+  for (row = 1; row < NRows + 1; row++) {
+    for (col = 1; col < NCols + 1; col++) {
+      const int state = Trees[TREE_MAP(row, col, NColsPlusBounds)];
+      const int64_t index = NEW_TREE_MAP(row, col, NCols);
+
+      if (IsStateOnFire(state, nMaxBurnSteps)) {
+        NewTrees[index] = ContinueBurningTree(state, CellBurnSteps[index],
+            nMaxBurnSteps);
+
+        CurStats.nBurning++;
+        AddToBoundingBox(&CurStats, row, col);
+      }
+      else if (state >= nMaxBurnSteps) {
+        CurStats.nBurntOut++;
+        AddToBoundingBox(&CurStats, row, col);
+      }
+    }
+  }
+}
+
+/* BurnNew() with the burn probability and wind of each tree from the map,
+   adding up the fire front in CurStats */
+void BurnNewMap() {
+  const int nColsPlusBounds = NColsPlusBounds;
+  const int nMaxBurnSteps = NMaxBurnSteps;
+  int row;
+  int col;
+
+  for (row = 1; row < NRows + 1; row++) {
+    for (col = 1; col < NCols + 1; col++) {
+      const int *tree = &Trees[TREE_MAP(row, col, nColsPlusBounds)];
+
+      if (*tree == 0) {
+        const bool top    = IsStateOnFire(tree[-nColsPlusBounds],
+                                          nMaxBurnSteps);
+        const bool left   = IsStateOnFire(tree[-1], nMaxBurnSteps);
+        const bool bottom = IsStateOnFire(tree[nColsPlusBounds],
+                                          nMaxBurnSteps);
+        const bool right  = IsStateOnFire(tree[1], nMaxBurnSteps);
+        const int nBurningNeighbors = top + left + bottom + right;
+        const int64_t index = NEW_TREE_MAP(row, col, NCols);
+
+        /* Each burning neighbor is an edge of the fire front */
+        CurStats.perimeter += nBurningNeighbors;
+
+        if (nBurningNeighbors > 0 &&
+            CatchesFireWithChance(row, col,
+              CellChance(index, top, left, bottom, right))) {
+          NewTrees[index] = 1;
+          NBurnedTrees++;
+        }
+      }
+    }
+  }
+}
+
+/* StepFused() with the values of each tree from the map */
+void StepFusedMap() {
+  const int nColsPlusBounds = NColsPlusBounds;
+  const int nMaxBurnSteps = NMaxBurnSteps;
+  const bool isCounterRand = IsCounterRand;
+  int *swap;
+  int row;
+  int col;
+
+  for (row = 1; row < NRows + 1; row++) {
+    const int *cur = &Trees[TREE_MAP(row, 0, nColsPlusBounds)];
+    int *next      = &NewTrees[TREE_MAP(row, 0, nColsPlusBounds)];
+    const uint32_t rowKey = CounterRowKey(RandSeed, CurStep, row);
+
+    for (col = 1; col < NCols + 1; col++) {
+      const int state = cur[col];
+      const int64_t index = NEW_TREE_MAP(row, col, NCols);
+
+      if (IsStateOnFire(state, nMaxBurnSteps)) {
+        /* Keep burning until out of fuel */
+        next[col] = ContinueBurningTree(state, CellBurnSteps[index],
+            nMaxBurnSteps);
+      }
+      else if (state == 0) {
+        const bool top    = IsStateOnFire(cur[col - nColsPlusBounds],
+                                          nMaxBurnSteps);
+        const bool left   = IsStateOnFire(cur[col - 1], nMaxBurnSteps);
+        const bool bottom = IsStateOnFire(cur[col + nColsPlusBounds],
+                                          nMaxBurnSteps);
+        const bool right  = IsStateOnFire(cur[col + 1], nMaxBurnSteps);
+        int chance;
+
+        next[col] = 0;
+        if (top || left || bottom || right) {
+          chance = CellChance(index, top, left, bottom, right);
+          if (isCounterRand ?
+              CounterCatchesFire(rowKey, col, CounterThreshold(chance)) :
+              CatchesFireWithChance(row, col, chance)) {
+            /* Catch the tree on fire */
+            next[col] = 1;
+            NBurnedTrees++;
+          }
+        }
+      }
+      else {
+        /* Burnt out */
+        next[col] = state;
+      }
+    }
+  }
+
+  swap = Trees;
+  Trees = NewTrees;
+  NewTrees = swap;
+}
+
+/* Unmap the map file */
+void CloseRaster() {
+  if (Mapping != NULL) {
+    munmap(Mapping, MappingSize);
+    Mapping = NULL;
+  }
+}
@@ -0,0 +1,95 @@
+/* Memory for the forests of the forest fire model.
+
+   Forests are mapped straight from the kernel rather than taken from
+   malloc(). Big forests are first tried on explicit huge pages
+   (MAP_HUGETLB), which only exist if the administrator reserved some with
+   vm.nr_hugepages, and otherwise on ordinary pages with a request for
+   transparent huge pages (MADV_HUGEPAGE). Either way a sweep over the
+   forest needs far fewer TLB entries than with 4 KB pages.
+
+   Successive forests start FOREST_COLOR_SIZE bytes further into their first
+   page. Otherwise Trees[i] and NewTrees[i] would sit at the same offset in
+   their huge pages, land in the same cache set, and evict each other in the
+   fused sweeps (which ran 2x slower that way).
+
+   The kernel gives each page to the NUMA node of the thread that first
+   writes it, so no page is written here; see InitData() in fire-serial.c.
+   */
+
+#include <stdint.h> /* uintptr_t */
+#include <sys/mman.h> /* mmap(), munmap(), madvise() */
+#include "fire-serial.h"
+
+/* Define the size of a huge page; forests at least this big are rounded up
+   to a whole number of huge pages */
+#define HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+/* Define the size of an ordinary page, which every mapping starts on */
+#define PAGE_SIZE_BYTES ((size_t)4096)
+
+/* Define how far apart in their first page successive forests start, and
+   after how many forests that starts over */
+#define FOREST_COLOR_SIZE ((size_t)256)
+#define N_FOREST_COLORS 16
+
+static int NForests = 0; /* Forests allocated so far */
+
+/* Return the number of bytes actually mapped for a forest
+
+   @param size The number of bytes asked for
+   @return The number of bytes mapped
+   */
+static size_t MappedSize(const size_t size) {
+  return size < HUGE_PAGE_SIZE ? size :
+    (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+/* Allocate memory for a forest, on huge pages if possible. The memory is
+   zero, but no page of it has been touched yet.
+
+   @param size The number of bytes
+   @return The memory, or NULL if there is not enough
+   */
+void *AllocateForest(const size_t size) {
+  const size_t offset = (size_t)(NForests++ % N_FOREST_COLORS) *
+    FOREST_COLOR_SIZE;
+  const size_t mappedSize = MappedSize(size + PAGE_SIZE_BYTES);
+  void *forest;
+
+#ifdef MAP_HUGETLB
+  if (mappedSize >= HUGE_PAGE_SIZE) {
+    forest = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (forest != MAP_FAILED) {
+      return (char*)forest + offset;
+    }
+  }
+#endif
+
+  /* No huge pages reserved; fall back to ordinary pages */
+  forest = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (forest == MAP_FAILED) {
+    return NULL;
+  }
+#ifdef MADV_HUGEPAGE
+  if (mappedSize >= HUGE_PAGE_SIZE) {
+    /* Ask for transparent huge pages; only a hint */
+    madvise(forest, mappedSize, MADV_HUGEPAGE);
+  }
+#endif
+  return (char*)forest + offset;
+}
+
+/* Free memory allocated by AllocateForest()
+
+   @param forest The memory, or NULL
+   @param size The number of bytes it was allocated with
+   */
+void FreeForest(void *forest, const size_t size) {
+  if (forest != NULL) {
+    /* The mapping starts on the page the forest starts in */
+    munmap((void*)((uintptr_t)forest & ~(uintptr_t)(PAGE_SIZE_BYTES - 1)),
+        MappedSize(size + PAGE_SIZE_BYTES));
+  }
+}
@@ -0,0 +1,158 @@
+/* MPI engine for the forest fire model (built as fire-mpi with
+   make fire-mpi).
+
+   The rows of the forest are split into blocks, one per MPI rank, so the
+   whole forest never has to fit in the memory of one node. Each rank keeps
+   its rows in the usual padded layout: the boundary columns are burnt out,
+   and the row above and below the block are ghost rows holding copies of
+   the neighbor ranks' edge rows (or the burnt-out boundary at the top and
+   bottom of the forest). Each time step the ghost rows are exchanged while
+   the rows that do not need them are updated.
+
+   Catching fire uses the counter-based generator in fire-rng.h with global
+   row numbers, so the result matches fire-serial -k for any number of ranks.
+   */
+
+#include <mpi.h> /* MPI_Isend(), MPI_Irecv(), MPI_Waitall(), MPI_Reduce() */
+#include <stdlib.h> /* calloc(), free(), exit() */
+#include "fire-serial.h"
+#include "fire-kernel.h"
+
+/* Define tags for messages going up and down the forest */
+#define TAG_UP 1
+#define TAG_DOWN 2
+
+static int NRanks; /* Number of MPI ranks */
+static int RankAbove; /* Rank holding the rows above this block */
+static int RankBelow; /* Rank holding the rows below this block */
+static int FirstRow; /* Global row index of the first row of this block */
+static int NLocalRows; /* Number of rows in this block */
+static int *LocalTrees; /* This block plus ghost rows and boundary columns */
+static int *NewLocalTrees; /* Same layout, for the next time step */
+static int64_t NLocalBurnedTrees; /* Trees this rank caught on fire */
+
+/* Split the rows among the ranks and set up this rank's block
+
+   @param firstRow The global row index of the first tree to light
+   @param firstCol The global column index of the first tree to light
+   */
+void InitMpi(const int firstRow, const int firstCol) {
+  size_t nLocalTrees;
+  int row;
+  int col;
+  int64_t i;
+
+  MPI_Comm_size(MPI_COMM_WORLD, &NRanks);
+  if (NRows < NRanks) {
+    if (Rank == 0) {
+      fprintf(stderr, "ERROR: need at least one row per MPI rank\n");
+    }
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+
+  /* Give the first NRows % NRanks ranks one extra row */
+  NLocalRows = NRows / NRanks + (Rank < NRows % NRanks ? 1 : 0);
+  FirstRow = 1 + Rank * (NRows / NRanks) +
+    (Rank < NRows % NRanks ? Rank : NRows % NRanks);
+  RankAbove = Rank > 0 ? Rank - 1 : MPI_PROC_NULL;
+  RankBelow = Rank < NRanks - 1 ? Rank + 1 : MPI_PROC_NULL;
+
+  nLocalTrees = (size_t)(NLocalRows + 2) * NColsPlusBounds;
+  LocalTrees = (int*)calloc(nLocalTrees, sizeof(int));
+  NewLocalTrees = (int*)calloc(nLocalTrees, sizeof(int));
+  if (LocalTrees == NULL || NewLocalTrees == NULL) {
+    fprintf(stderr, "ERROR: rank %d is out of memory for its rows\n", Rank);
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+
+  /* Set the boundaries as burnt out; ghost rows that belong to another rank
+     are overwritten by the first exchange */
+  for (row = 0; row < NLocalRows + 2; row++) {
+    for (col = 0; col < NColsPlusBounds; col++) {
+      if (col == 0 || col == NCols + 1 ||
+          (row == 0 && RankAbove == MPI_PROC_NULL) ||
+          (row == NLocalRows + 1 && RankBelow == MPI_PROC_NULL)) {
+        i = TREE_MAP(row, col, NColsPlusBounds);
+        LocalTrees[i] = NewLocalTrees[i] = NMaxBurnSteps;
+      }
+    }
+  }
+
+  /* Light the first tree on fire if it is in this block */
+  NLocalBurnedTrees = 0;
+  if (firstRow >= FirstRow && firstRow < FirstRow + NLocalRows) {
+    i = TREE_MAP(firstRow - FirstRow + 1, firstCol, NColsPlusBounds);
+    LocalTrees[i] = NewLocalTrees[i] = 1;
+    NLocalBurnedTrees++;
+  }
+}
+
+/* Advance one row of this block by one time step
+
+   @param localRow The row index within this block, from 1 to NLocalRows
+   */
+static void StepMpiRow(const int localRow) {
+  const int nColsPlusBounds = NColsPlusBounds;
+  const int nMaxBurnSteps = NMaxBurnSteps;
+  const uint64_t threshold = CounterThreshold(BurnProb);
+  const uint32_t rowKey = CounterRowKey(RandSeed, CurStep,
+      FirstRow + localRow - 1);
+  const int *above = &LocalTrees[TREE_MAP(localRow - 1, 0, nColsPlusBounds)];
+  const int *cur   = &LocalTrees[TREE_MAP(localRow,     0, nColsPlusBounds)];
+  const int *below = &LocalTrees[TREE_MAP(localRow + 1, 0, nColsPlusBounds)];
+  int *next        = &NewLocalTrees[TREE_MAP(localRow, 0, nColsPlusBounds)];
+
+  NLocalBurnedTrees += StepRowFour(above, cur, below, next, 1, NCols,
+      nMaxBurnSteps, true, rowKey, threshold, FirstRow + localRow - 1, 0,
+      NULL);
+}
+
+/* Advance this block by one time step, exchanging ghost rows with the
+   neighbor ranks while the rows that do not need them are updated */
+void StepMpi() {
+  MPI_Request requests[4];
+  int *swap;
+  int row;
+
+  /* Receive the neighbors' edge rows into the ghost rows and send this
+     block's edge rows to them */
+  MPI_Irecv(&LocalTrees[TREE_MAP(0, 0, NColsPlusBounds)], NColsPlusBounds,
+      MPI_INT, RankAbove, TAG_DOWN, MPI_COMM_WORLD, &requests[0]);
+  MPI_Irecv(&LocalTrees[TREE_MAP(NLocalRows + 1, 0, NColsPlusBounds)],
+      NColsPlusBounds, MPI_INT, RankBelow, TAG_UP, MPI_COMM_WORLD,
+      &requests[1]);
+  MPI_Isend(&LocalTrees[TREE_MAP(1, 0, NColsPlusBounds)], NColsPlusBounds,
+      MPI_INT, RankAbove, TAG_UP, MPI_COMM_WORLD, &requests[2]);
+  MPI_Isend(&LocalTrees[TREE_MAP(NLocalRows, 0, NColsPlusBounds)],
+      NColsPlusBounds, MPI_INT, RankBelow, TAG_DOWN, MPI_COMM_WORLD,
+      &requests[3]);
+
+  /* Update the rows whose neighbors are all in this block */
+  for (row = 2; row < NLocalRows; row++) {
+    StepMpiRow(row);
+  }
+
+  /* Update the edge rows once the ghost rows have arrived */
+  MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
+  StepMpiRow(1);
+  if (NLocalRows > 1) {
+    StepMpiRow(NLocalRows);
+  }
+
+  swap = LocalTrees;
+  LocalTrees = NewLocalTrees;
+  NewLocalTrees = swap;
+}
+
+/* Add up the trees caught on fire by every rank into NBurnedTrees on rank 0
+   */
+void ReduceMpi() {
+  MPI_Reduce(&NLocalBurnedTrees, &NBurnedTrees, 1, MPI_INT64_T, MPI_SUM, 0,
+      MPI_COMM_WORLD);
+}
+
+/* Free this rank's block */
+void FreeMpi() {
+  free(LocalTrees);
+  free(NewLocalTrees);
+}
@@ -0,0 +1,244 @@
+/* Binary, asynchronous output of tree data for the forest fire model.
+
+   OutputData() formats every tree of every time step as text, which can take
+   longer than the simulation itself. Here the stepping loop only copies the
+   tree states into one of a ring of frame buffers; a background writer
+   thread compares each frame with the previous one and writes either the
+   trees that changed or the whole frame, whichever is smaller, in the
+   format described in fire-output.h. The stepping loop only waits when every
+   buffer of the ring is still waiting to be written.
+   */
+
+#include <pthread.h> /* pthread_create(), pthread_join(), mutexes, conditions */
+#include <stdlib.h> /* malloc(), free(), exit() */
+#include <string.h> /* memcpy(), memset() */
+#include "fire-serial.h"
+#include "fire-output.h"
+
+/* Define the number of frames that can wait to be written */
+#define N_FRAME_BUFFERS 4
+
+struct FrameBuffer {
+  int step; /* The time step the frame was taken at */
+  void *cells; /* The state of every tree */
+};
+
+static struct FrameBuffer Ring[N_FRAME_BUFFERS];
+static int RingHead; /* Next buffer to fill */
+static int RingTail; /* Next buffer to write */
+static int NQueued; /* Buffers filled but not written yet */
+static bool IsClosing; /* No more frames will be queued */
+static pthread_mutex_t RingLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t RingNotEmpty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t RingNotFull = PTHREAD_COND_INITIALIZER;
+static pthread_t Writer;
+
+static FILE *BinaryFile;
+static int CellBytes; /* Bytes per tree state */
+static void *PrevCells; /* The last frame written, NULL before the first */
+static int64_t *DeltaIndices; /* Trees that changed since the last frame */
+static void *DeltaCells; /* Their new states */
+
+/* Write bytes to the binary output file, exiting on failure
+
+   @param data The bytes to write
+   @param size The number of bytes
+   */
+static void WriteBytes(const void *data, const size_t size) {
+  if (size > 0 && fwrite(data, size, 1, BinaryFile) != 1) {
+    fprintf(stderr, "ERROR: could not write binary output\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/* Allocate memory for binary output, exiting on failure
+
+   @param size The number of bytes
+   @return The memory
+   */
+static void *AllocateOutput(const size_t size) {
+  void *memory = malloc(size);
+
+  if (memory == NULL) {
+    fprintf(stderr, "ERROR: out of memory for binary output\n");
+    exit(EXIT_FAILURE);
+  }
+  return memory;
+}
+
+/* Write one frame, as a delta against the previous frame if that is smaller
+
+   @param frame The frame to write; its cells are swapped with PrevCells
+   */
+static void WriteFrame(struct FrameBuffer *frame) {
+  struct FrameHeader header;
+  int64_t nChanged = 0;
+  int64_t index;
+  void *swap;
+
+  header.step = frame->step;
+  header.kind = FRAME_FULL;
+  header.nCells = NTrees;
+
+  if (PrevCells != NULL) {
+    /* Find the trees that changed, giving up once a full frame is smaller */
+    const int64_t maxChanged = (int64_t)NTrees * CellBytes /
+      (sizeof(int64_t) + CellBytes);
+
+    for (index = 0; index < NTrees && nChanged <= maxChanged; index++) {
+      const int state = GetFrameCell(frame->cells, index, CellBytes);
+
+      if (state != GetFrameCell(PrevCells, index, CellBytes)) {
+        if (nChanged < maxChanged) {
+          DeltaIndices[nChanged] = index;
+          SetFrameCell(DeltaCells, nChanged, CellBytes, state);
+        }
+        nChanged++;
+      }
+    }
+
+    if (nChanged < maxChanged) {
+      header.kind = FRAME_DELTA;
+      header.nCells = nChanged;
+    }
+  }
+
+  WriteBytes(&header, sizeof(header));
+  if (header.kind == FRAME_DELTA) {
+    WriteBytes(DeltaIndices, nChanged * sizeof(int64_t));
+    WriteBytes(DeltaCells, nChanged * CellBytes);
+  }
+  else {
+    WriteBytes(frame->cells, (size_t)NTrees * CellBytes);
+  }
+
+  /* Keep this frame to compare the next one against, and reuse the old one
+     as a buffer */
+  if (PrevCells == NULL) {
+    PrevCells = AllocateOutput((size_t)NTrees * CellBytes);
+  }
+  swap = PrevCells;
+  PrevCells = frame->cells;
+  frame->cells = swap;
+}
+
+/* Write queued frames until the output is closed
+
+   @param arg Unused
+   @return NULL
+   */
+static void *WriteFrames(void *arg) {
+  (void)arg;
+
+  while (true) {
+    struct FrameBuffer *frame;
+
+    pthread_mutex_lock(&RingLock);
+    while (NQueued == 0 && !IsClosing) {
+      pthread_cond_wait(&RingNotEmpty, &RingLock);
+    }
+    if (NQueued == 0) {
+      pthread_mutex_unlock(&RingLock);
+      break;
+    }
+    frame = &Ring[RingTail];
+    pthread_mutex_unlock(&RingLock);
+
+    /* Write without holding the lock so the stepping loop can keep filling
+       other buffers */
+    WriteFrame(frame);
+
+    pthread_mutex_lock(&RingLock);
+    RingTail = (RingTail + 1) % N_FRAME_BUFFERS;
+    NQueued--;
+    pthread_cond_signal(&RingNotFull);
+    pthread_mutex_unlock(&RingLock);
+  }
+  return NULL;
+}
+
+/* Write the file header and start the writer thread
+
+   @param file The open output file
+   */
+void OpenBinaryOutput(FILE *file) {
+  struct FrameFileHeader header;
+  int i;
+
+  BinaryFile = file;
+  CellBytes = FrameCellBytes(NMaxBurnSteps);
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, FRAME_FILE_MAGIC, FRAME_FILE_MAGIC_LENGTH);
+  header.nRows = NRows;
+  header.nCols = NCols;
+  header.burnProb = BurnProb;
+  header.nMaxBurnSteps = NMaxBurnSteps;
+  header.nSteps = NSteps;
+  header.randSeed = RandSeed;
+  header.cellBytes = CellBytes;
+  header.stateDigits = NMaxBurnStepsDigits;
+  WriteBytes(&header, sizeof(header));
+
+  for (i = 0; i < N_FRAME_BUFFERS; i++) {
+    Ring[i].cells = AllocateOutput((size_t)NTrees * CellBytes);
+  }
+  /* A delta is only written while it is smaller than a full frame */
+  DeltaIndices = (int64_t*)AllocateOutput((size_t)NTrees * CellBytes /
+      (sizeof(int64_t) + CellBytes) * sizeof(int64_t) + sizeof(int64_t));
+  DeltaCells = AllocateOutput((size_t)NTrees * CellBytes /
+      (sizeof(int64_t) + CellBytes) * CellBytes + CellBytes);
+
+  if (pthread_create(&Writer, NULL, WriteFrames, NULL) != 0) {
+    fprintf(stderr, "ERROR: could not start the binary output thread\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/* Copy the trees of the current time step into the ring for the writer
+   thread, waiting only if every buffer is still queued */
+void QueueBinaryFrame() {
+  struct FrameBuffer *frame;
+  int row;
+  int col;
+
+  pthread_mutex_lock(&RingLock);
+  while (NQueued == N_FRAME_BUFFERS) {
+    pthread_cond_wait(&RingNotFull, &RingLock);
+  }
+  frame = &Ring[RingHead];
+  pthread_mutex_unlock(&RingLock);
+
+  frame->step = CurStep;
+  for (row = 1; row < NRows + 1; row++) {
+    for (col = 1; col < NCols + 1; col++) {
+      SetFrameCell(frame->cells, NEW_TREE_MAP(row, col, (int64_t)NCols),
+          CellBytes, GetTreeState(row, col));
+    }
+  }
+
+  pthread_mutex_lock(&RingLock);
+  RingHead = (RingHead + 1) % N_FRAME_BUFFERS;
+  NQueued++;
+  pthread_cond_signal(&RingNotEmpty);
+  pthread_mutex_unlock(&RingLock);
+}
+
+/* Wait for every queued frame to be written, then stop the writer thread and
+   free its buffers; the caller closes the file */
+void CloseBinaryOutput() {
+  int i;
+
+  pthread_mutex_lock(&RingLock);
+  IsClosing = true;
+  pthread_cond_signal(&RingNotEmpty);
+  pthread_mutex_unlock(&RingLock);
+  pthread_join(Writer, NULL);
+
+  for (i = 0; i < N_FRAME_BUFFERS; i++) {
+    free(Ring[i].cells);
+  }
+  free(PrevCells);
+  free(DeltaIndices);
+  free(DeltaCells);
+}
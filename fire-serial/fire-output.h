@@ -0,0 +1,131 @@
+/* Binary output format for the forest fire model, written by fire-output.c
+   and turned back into the text format of OutputData() by fire-convert.c.
+
+   The file starts with a FrameFileHeader. Each output time step then adds a
+   FrameHeader followed by either
+
+   FRAME_FULL  - the state of every tree, row by row, or
+   FRAME_DELTA - the nCells indices (int64_t, row * NCols + col counting
+                 from 0) of the trees that changed since the previous frame,
+                 then the nCells new states
+
+   Each state takes cellBytes bytes. Numbers are in the byte order of the
+   machine that wrote the file. WriteTextFrame() is the text format itself,
+   shared by OutputData() and fire-convert.c, and stateDigits carries the
+   width OutputData() would have used.
+   */
+
+#ifndef FIRE_OUTPUT_H
+#define FIRE_OUTPUT_H
+
+#include <stdint.h> /* int32_t, int64_t */
+#include <stdio.h> /* fprintf() */
+
+/* Define the characters at the start of every binary output file */
+#define FRAME_FILE_MAGIC "FIREBIN1"
+#define FRAME_FILE_MAGIC_LENGTH 8
+
+/* Define the kinds of frame */
+#define FRAME_FULL 0
+#define FRAME_DELTA 1
+
+struct FrameFileHeader {
+  char magic[FRAME_FILE_MAGIC_LENGTH];
+  int32_t nRows;
+  int32_t nCols;
+  int32_t burnProb;
+  int32_t nMaxBurnSteps;
+  int32_t nSteps;
+  int32_t randSeed;
+  int32_t cellBytes; /* 1, 2 or 4 bytes per tree state */
+  int32_t stateDigits; /* Smallest width of a state in the text format */
+};
+
+struct FrameHeader {
+  int32_t step;
+  int32_t kind; /* FRAME_FULL or FRAME_DELTA */
+  int64_t nCells; /* Number of tree states that follow */
+};
+
+/* Return how many bytes a tree state takes in the binary output
+
+   @param nMaxBurnSteps The largest tree state
+   @return 1, 2 or 4
+   */
+static inline int FrameCellBytes(const int nMaxBurnSteps) {
+  return nMaxBurnSteps < 256 ? 1 : nMaxBurnSteps < 65536 ? 2 : 4;
+}
+
+/* Read one tree state from a frame
+
+   @param cells The tree states of the frame
+   @param index The index of the tree in the frame
+   @param cellBytes The number of bytes per state
+   @return The tree state
+   */
+static inline int GetFrameCell(const void *cells, const int64_t index,
+    const int cellBytes) {
+  switch (cellBytes) {
+    case 1:
+      return ((const uint8_t*)cells)[index];
+    case 2:
+      return ((const uint16_t*)cells)[index];
+    default:
+      return ((const int32_t*)cells)[index];
+  }
+}
+
+/* Write one tree state into a frame
+
+   @param cells The tree states of the frame
+   @param index The index of the tree in the frame
+   @param cellBytes The number of bytes per state
+   @param state The tree state
+   */
+static inline void SetFrameCell(void *cells, const int64_t index,
+    const int cellBytes, const int state) {
+  switch (cellBytes) {
+    case 1:
+      ((uint8_t*)cells)[index] = state;
+      break;
+    case 2:
+      ((uint16_t*)cells)[index] = state;
+      break;
+    default:
+      ((int32_t*)cells)[index] = state;
+  }
+}
+
+/* Write the tree states of one time step in the text format of -o
+
+   @param file The text file
+   @param step The time step
+   @param nRows The number of rows of trees
+   @param nCols The number of columns of trees
+   @param stateDigits The smallest width of each state
+   @param getState Return the state of the tree at a row and column, both
+     counting from 0
+   @param context Passed on to getState
+   */
+static inline void WriteTextFrame(FILE *file, const int step,
+    const int nRows, const int nCols, const int stateDigits,
+    int (*getState)(int row, int col, const void *context),
+    const void *context) {
+  int row;
+  int col;
+
+  /* Write the header for the time step */
+  fprintf(file, "Time step %d\n", step);
+
+  for (row = 0; row < nRows; row++) {
+    for (col = 0; col < nCols; col++) {
+      fprintf(file, "%*d ", stateDigits, getState(row, col, context));
+    }
+    fprintf(file, "\n");
+  }
+
+  /* Write the newline between time steps */
+  fprintf(file, "\n");
+}
+
+#endif
@@ -0,0 +1,112 @@
+/* Multi-threaded time step for the forest fire model.
+
+   The rows of the forest are split among OpenMP threads. Catching fire uses
+   the counter-based generator in fire-rng.h instead of random(), so the
+   percentage of trees burned does not depend on the number of threads.
+   With -S each thread also adds up the statistics of its rows as it goes,
+   and the totals are merged once at the end of the time step.
+   */
+
+#include "fire-serial.h"
+#include "fire-rng.h"
+
+/* Advance every tree by one time step, splitting the rows among threads
+
+   @param stats Statistics to add the forest before the time step to, or
+     NULL
+   */
+void StepParallel(struct ForestStats *stats) {
+  const int nRows = NRows;
+  const int nCols = NCols;
+  const int nColsPlusBounds = NColsPlusBounds;
+  const int nMaxBurnSteps = NMaxBurnSteps;
+  const uint32_t seed = RandSeed;
+  const uint32_t step = CurStep;
+  const uint64_t threshold = CounterThreshold(BurnProb);
+  int *trees = Trees;
+  int *newTrees = NewTrees;
+  const bool isMeasuring = stats != NULL;
+  int64_t nBurnedTrees = 0; /* Trees caught on fire during this time step */
+  int row;
+
+#pragma omp parallel default(none) private(row) \
+  shared(nRows, nCols, nColsPlusBounds, nMaxBurnSteps, seed, step, \
+      threshold, trees, newTrees, isMeasuring, stats) \
+  reduction(+:nBurnedTrees)
+  {
+    struct ForestStats threadStats; /* Of this thread's rows */
+
+    ClearStats(&threadStats);
+
+    /* For trees already burning, increment the number of time steps they
+       have burned */
+#pragma omp for schedule(static)
+    for (row = 1; row < nRows + 1; row++) {
+      int col;
+
+      for (col = 1; col < nCols + 1; col++) {
+        const int state = trees[TREE_MAP(row, col, nColsPlusBounds)];
+
+        if (IsStateOnFire(state, nMaxBurnSteps)) {
+          newTrees[NEW_TREE_MAP(row, col, nCols)] = state + 1;
+          if (isMeasuring) {
+            threadStats.nBurning++;
+            AddToBoundingBox(&threadStats, row, col);
+          }
+        }
+        else if (isMeasuring && state >= nMaxBurnSteps) {
+          threadStats.nBurntOut++;
+          AddToBoundingBox(&threadStats, row, col);
+        }
+      }
+    }
+
+    /* Find trees that are not on fire yet and try to catch them on fire from
+       burning neighbor trees */
+#pragma omp for schedule(static)
+    for (row = 1; row < nRows + 1; row++) {
+      const uint32_t rowKey = CounterRowKey(seed, step, row);
+      int col;
+
+      for (col = 1; col < nCols + 1; col++) {
+        if (trees[TREE_MAP(row, col, nColsPlusBounds)] == 0) {
+          const bool isTop = IsStateOnFire(
+              trees[TREE_MAP(row-1, col, nColsPlusBounds)], nMaxBurnSteps);
+          const bool isLeft = IsStateOnFire(
+              trees[TREE_MAP(row, col-1, nColsPlusBounds)], nMaxBurnSteps);
+          const bool isBottom = IsStateOnFire(
+              trees[TREE_MAP(row+1, col, nColsPlusBounds)], nMaxBurnSteps);
+          const bool isRight = IsStateOnFire(
+              trees[TREE_MAP(row, col+1, nColsPlusBounds)], nMaxBurnSteps);
+
+          /* Each burning neighbor is an edge of the fire front */
+          threadStats.perimeter += isTop + isLeft + isBottom + isRight;
+
+          if ((isTop || isLeft || isBottom || isRight) &&
+              CounterCatchesFire(rowKey, col, threshold)) {
+            newTrees[NEW_TREE_MAP(row, col, nCols)] = 1;
+            nBurnedTrees++;
+          }
+        }
+      }
+    }
+
+    /* Copy new tree data into old tree data */
+#pragma omp for schedule(static)
+    for (row = 1; row < nRows + 1; row++) {
+      int col;
+
+      for (col = 1; col < nCols + 1; col++) {
+        trees[         TREE_MAP(row, col, nColsPlusBounds)] =
+          newTrees[NEW_TREE_MAP(row, col, nCols)];
+      }
+    }
+
+    if (isMeasuring) {
+#pragma omp critical
+      MergeStats(stats, &threadStats);
+    }
+  }
+
+  NBurnedTrees += nBurnedTrees;
+}
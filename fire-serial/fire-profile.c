@@ -0,0 +1,315 @@
+/* Per-phase timing and hardware counters for the forest fire model.
+
+   Each phase of the simulation - initializing, each of the three phases of
+   a time step (or the single sweep of the engines that fuse them), writing
+   output and checkpointing - is timed with a monotonic clock every time it
+   runs. Where the kernel allows it, a group of perf_event_open() counters
+   (cycles, instructions, last level cache misses) is read at the same
+   points. The counters only count the main thread.
+
+   The times for each time step are written to the report as soon as the
+   step finishes, so memory use does not grow with the number of steps, and
+   the cumulative time and counts for each phase are written at the end. The
+   report is JSON if its filename ends in ".json" and CSV otherwise.
+
+   Timing a phase costs two clock reads and, with counters, two read()
+   calls, which is small next to a sweep over any forest worth timing.
+   */
+
+#include <linux/perf_event.h> /* struct perf_event_attr, PERF_* */
+#include <stdlib.h> /* exit() */
+#include <string.h> /* memset(), strlen(), strcmp() */
+#include <sys/ioctl.h> /* ioctl() */
+#include <sys/syscall.h> /* SYS_perf_event_open */
+#include <time.h> /* clock_gettime() */
+#include <unistd.h> /* syscall(), read(), close() */
+#include "fire-serial.h"
+
+/* Define the hardware counters read for each phase */
+#define N_COUNTERS 3
+static const unsigned long long COUNTER_CONFIGS[N_COUNTERS] = {
+  PERF_COUNT_HW_CPU_CYCLES,
+  PERF_COUNT_HW_INSTRUCTIONS,
+  PERF_COUNT_HW_CACHE_MISSES
+};
+static const char *COUNTER_NAMES[N_COUNTERS] = {
+  "cycles", "instructions", "llc_misses"
+};
+
+/* Define the name of each phase in the report, in the order of enum Phase */
+static const char *PHASE_NAMES[N_PHASES] = {
+  "init", "continue_burning", "burn_new", "advance_time", "step", "output",
+  "checkpoint"
+};
+
+/* The time and counts of one phase */
+struct PhaseCounts {
+  double seconds;
+  uint64_t counters[N_COUNTERS];
+};
+
+bool IsProfiling = false;
+static FILE *ReportFile;
+static bool IsJsonReport;
+static int CounterFds[N_COUNTERS]; /* CounterFds[0] leads the group */
+static bool AreCountersOpen = false;
+static struct PhaseCounts PhaseStart; /* Readings when the phase began */
+static struct PhaseCounts StepCounts[N_PHASES]; /* This time step */
+static bool DidPhaseRun[N_PHASES]; /* This time step */
+static struct PhaseCounts TotalCounts[N_PHASES]; /* Every time step */
+static int64_t NPhaseCalls[N_PHASES];
+static bool IsFirstStepReported;
+
+/* Read the clock and, if open, the counters
+
+   @param counts Where to put the readings
+   */
+static void ReadCounts(struct PhaseCounts *counts) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  counts->seconds = now.tv_sec + 1.0e-9 * now.tv_nsec;
+
+  memset(counts->counters, 0, sizeof(counts->counters));
+  if (AreCountersOpen) {
+    /* One read() of the group leader gives every counter in the group,
+       after the number of counters */
+    uint64_t values[1 + N_COUNTERS];
+    int i;
+
+    if (read(CounterFds[0], values, sizeof(values)) ==
+        (ssize_t)sizeof(values)) {
+      for (i = 0; i < N_COUNTERS; i++) {
+        counts->counters[i] = values[1 + i];
+      }
+    }
+  }
+}
+
+/* Open the hardware counters as one group for the calling thread
+
+   @return Whether every counter could be opened
+   */
+static bool OpenCounters() {
+  struct perf_event_attr attr;
+  int i;
+
+  for (i = 0; i < N_COUNTERS; i++) {
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = COUNTER_CONFIGS[i];
+    attr.disabled = i == 0; /* Start the whole group at once below */
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    CounterFds[i] = syscall(SYS_perf_event_open, &attr, 0, -1,
+        i == 0 ? -1 : CounterFds[0], 0);
+    if (CounterFds[i] < 0) {
+      /* Not allowed (see /proc/sys/kernel/perf_event_paranoid) or not
+         supported; time without counters */
+      while (i-- > 0) {
+        close(CounterFds[i]);
+      }
+      return false;
+    }
+  }
+
+  ioctl(CounterFds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  return true;
+}
+
+/* Write the time and, if available, counts of a phase to the report
+
+   @param counts The time and counts
+   */
+static void ReportCounts(const struct PhaseCounts *counts) {
+  int i;
+
+  if (IsJsonReport) {
+    fprintf(ReportFile, "[%.9f", counts->seconds);
+    for (i = 0; i < N_COUNTERS; i++) {
+      if (AreCountersOpen) {
+        fprintf(ReportFile, ", %llu",
+            (unsigned long long)counts->counters[i]);
+      }
+      else {
+        fprintf(ReportFile, ", null");
+      }
+    }
+    fprintf(ReportFile, "]");
+  }
+  else {
+    fprintf(ReportFile, "%.9f", counts->seconds);
+    for (i = 0; i < N_COUNTERS; i++) {
+      if (AreCountersOpen) {
+        fprintf(ReportFile, ",%llu", (unsigned long long)counts->counters[i]);
+      }
+      else {
+        fprintf(ReportFile, ",");
+      }
+    }
+    fprintf(ReportFile, "\n");
+  }
+}
+
+/* Open the report and the hardware counters and start profiling
+
+   @param filename The report file; JSON if it ends in ".json", else CSV
+   @param engineName The name of the selected engine
+   */
+void StartProfile(const char *filename, const char *engineName) {
+  const size_t length = strlen(filename);
+  int i;
+
+  ReportFile = fopen(filename, "w");
+  if (ReportFile == NULL) {
+    fprintf(stderr, "ERROR: could not open profile report '%s'\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  IsJsonReport = length >= 5 && strcmp(filename + length - 5, ".json") == 0;
+  AreCountersOpen = OpenCounters();
+  IsFirstStepReported = true;
+  IsProfiling = true;
+
+  if (IsJsonReport) {
+    fprintf(ReportFile, "{\n  \"engine\": \"%s\",\n  \"rows\": %d,\n"
+        "  \"cols\": %d,\n  \"burn_prob\": %d,\n  \"max_burn_steps\": %d,\n"
+        "  \"steps\": %d,\n  \"has_counters\": %s,\n  \"columns\": "
+        "[\"seconds\"", engineName, NRows, NCols, BurnProb, NMaxBurnSteps,
+        NSteps, AreCountersOpen ? "true" : "false");
+    for (i = 0; i < N_COUNTERS; i++) {
+      fprintf(ReportFile, ", \"%s\"", COUNTER_NAMES[i]);
+    }
+    fprintf(ReportFile, "],\n  \"per_step\": [");
+  }
+  else {
+    fprintf(ReportFile, "# engine=%s rows=%d cols=%d burn_prob=%d "
+        "max_burn_steps=%d steps=%d\n", engineName, NRows, NCols, BurnProb,
+        NMaxBurnSteps, NSteps);
+    fprintf(ReportFile, "step,phase,calls,seconds");
+    for (i = 0; i < N_COUNTERS; i++) {
+      fprintf(ReportFile, ",%s", COUNTER_NAMES[i]);
+    }
+    fprintf(ReportFile, "\n");
+  }
+}
+
+/* Start timing a phase
+
+   @param phase The phase
+   */
+void BeginPhase(const enum Phase phase) {
+  (void)phase;
+  if (IsProfiling) {
+    ReadCounts(&PhaseStart);
+  }
+}
+
+/* Stop timing a phase and add it to the totals and, unless it is the
+   initialization, to the current time step
+
+   @param phase The phase
+   */
+void EndPhase(const enum Phase phase) {
+  struct PhaseCounts end;
+  int i;
+
+  if (!IsProfiling) {
+    return;
+  }
+  ReadCounts(&end);
+
+  TotalCounts[phase].seconds += end.seconds - PhaseStart.seconds;
+  for (i = 0; i < N_COUNTERS; i++) {
+    TotalCounts[phase].counters[i] +=
+      end.counters[i] - PhaseStart.counters[i];
+  }
+  NPhaseCalls[phase]++;
+
+  if (phase != PHASE_INIT) {
+    StepCounts[phase].seconds += end.seconds - PhaseStart.seconds;
+    for (i = 0; i < N_COUNTERS; i++) {
+      StepCounts[phase].counters[i] +=
+        end.counters[i] - PhaseStart.counters[i];
+    }
+    DidPhaseRun[phase] = true;
+  }
+}
+
+/* Write the phases of a finished time step to the report
+
+   @param step The time step
+   */
+void EndProfileStep(const int step) {
+  int phase;
+
+  if (!IsProfiling) {
+    return;
+  }
+
+  if (IsJsonReport) {
+    fprintf(ReportFile, "%s\n    {\"time_step\": %d",
+        IsFirstStepReported ? "" : ",", step);
+  }
+  for (phase = 0; phase < N_PHASES; phase++) {
+    if (DidPhaseRun[phase]) {
+      if (IsJsonReport) {
+        fprintf(ReportFile, ", \"%s\": ", PHASE_NAMES[phase]);
+      }
+      else {
+        fprintf(ReportFile, "%d,%s,1,", step, PHASE_NAMES[phase]);
+      }
+      ReportCounts(&StepCounts[phase]);
+    }
+  }
+  if (IsJsonReport) {
+    fprintf(ReportFile, "}");
+  }
+
+  memset(StepCounts, 0, sizeof(StepCounts));
+  memset(DidPhaseRun, 0, sizeof(DidPhaseRun));
+  IsFirstStepReported = false;
+}
+
+/* Write the totals of every phase to the report and close it */
+void FinishProfile() {
+  int phase;
+
+  if (!IsProfiling) {
+    return;
+  }
+
+  if (IsJsonReport) {
+    fprintf(ReportFile, "\n  ],\n  \"total\": {");
+  }
+  for (phase = 0; phase < N_PHASES; phase++) {
+    if (IsJsonReport) {
+      fprintf(ReportFile, "%s\n    \"%s\": {\"calls\": %lld, \"counts\": ",
+          phase == 0 ? "" : ",", PHASE_NAMES[phase],
+          (long long)NPhaseCalls[phase]);
+      ReportCounts(&TotalCounts[phase]);
+      fprintf(ReportFile, "}");
+    }
+    else if (NPhaseCalls[phase] > 0) {
+      fprintf(ReportFile, "total,%s,%lld,", PHASE_NAMES[phase],
+          (long long)NPhaseCalls[phase]);
+      ReportCounts(&TotalCounts[phase]);
+    }
+  }
+  if (IsJsonReport) {
+    fprintf(ReportFile, "\n  }\n}\n");
+  }
+
+  fclose(ReportFile);
+  if (AreCountersOpen) {
+    int i;
+
+    for (i = 0; i < N_COUNTERS; i++) {
+      close(CounterFds[i]);
+    }
+    AreCountersOpen = false;
+  }
+  IsProfiling = false;
+}
@@ -0,0 +1,94 @@
+/* Counter-based random numbers for the forest fire model.
+
+   random() walks one shared sequence, so the chance a tree gets depends on
+   how many trees were checked before it. The generator below instead hashes
+   (seed, step, row, col) into a random number, so every tree gets the same
+   draw no matter which thread visits it or in what order.
+   */
+
+#ifndef FIRE_RNG_H
+#define FIRE_RNG_H
+
+#include <stdbool.h> /* bool type */
+#include <stdint.h> /* uint32_t, uint64_t */
+
+/* Odd constant used to spread consecutive column numbers apart */
+#define COUNTER_RAND_GOLDEN 0x9e3779b9U
+
+/* Scramble the bits of a 32-bit integer (the "lowbias32" integer hash)
+
+   @param x The integer to scramble
+   @return The scrambled integer
+   */
+static inline uint32_t MixBits(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7feb352dU;
+  x ^= x >> 15;
+  x *= 0x846ca68bU;
+  x ^= x >> 16;
+  return x;
+}
+
+/* Return the key shared by all trees of one row during one time step
+
+   @param seed Seed value for the random number generator
+   @param step The current time step
+   @param row The row index of the trees
+   @return The key to pass to CounterRand()
+   */
+static inline uint32_t CounterRowKey(const uint32_t seed, const uint32_t step,
+    const uint32_t row) {
+  return MixBits(MixBits(MixBits(seed) ^ step) + row);
+}
+
+/* Return the random number of one tree
+
+   @param rowKey The key returned by CounterRowKey() for the tree's row
+   @param col The column index of the tree
+   @return A random 32-bit integer
+   */
+static inline uint32_t CounterRand(const uint32_t rowKey, const uint32_t col) {
+  return MixBits(rowKey + col * COUNTER_RAND_GOLDEN);
+}
+
+/* Return the number that random draws must stay below to happen with a
+   given chance
+
+   @param percent The chance, as an integer [0..100]
+   @return ceil(percent / 100 * 2^32)
+   */
+static inline uint64_t CounterThreshold(const int percent) {
+  return (((uint64_t)percent << 32) + 99) / 100;
+}
+
+/* Return whether a tree next to a burning tree catches fire
+
+   @param rowKey The key returned by CounterRowKey() for the tree's row
+   @param col The column index of the tree
+   @param threshold The value returned by CounterThreshold() for BurnProb
+   @return Whether the tree catches fire
+   */
+static inline bool CounterCatchesFire(const uint32_t rowKey,
+    const uint32_t col, const uint64_t threshold) {
+  return CounterRand(rowKey, col) < threshold;
+}
+
+/* Choose a random tree of a forest from the seed alone, drawn as if at
+   "time step -1", so that every engine and ensemble run lights the same
+   tree without touching random()
+
+   @param seed Seed value for the random number generator
+   @param nRows The number of rows of trees
+   @param nCols The number of columns of trees
+   @param row Set to the row index of the tree, [1..nRows]
+   @param col Set to the column index of the tree, [1..nCols]
+   */
+static inline void CounterFirstTree(const uint32_t seed, const int nRows,
+    const int nCols, int *row, int *col) {
+  const uint32_t key = CounterRowKey(seed, (uint32_t)-1, 0);
+
+  *row = 1 + CounterRand(key, 0) % nRows;
+  *col = 1 + CounterRand(key, 1) % nCols;
+}
+
+#endif
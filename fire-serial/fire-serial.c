@@ -1,7 +1,8 @@
 /* Model of a forest fire - a 2D rectangular grid of trees is initialized
    with one random tree caught on fire. At each time step, trees that are not
-   on fire yet check their neighbors to the north, east, south, and west, and
-   if any of them are on fire, the tree catches fire with some percent chance.
+   on fire yet check their neighbors to the north, east, south, and west (or
+   a wider neighborhood chosen with -n), and if any of them are on fire, the
+   tree catches fire with some percent chance.
    The model runs for a certain number of time steps, which can be controlled
    by the user. At the end of the simulation, the program outputs the total
    percentage of trees burned. Tree data can also be output at each time step
@@ -18,9 +19,16 @@
 #include <stdbool.h> /* bool type */
 #include <stdio.h> /* printf() */
 #include <stdlib.h> /* atoi(), exit(), EXIT_FAILURE, malloc(), free(),
-                       random() */
-#include <string.h> /* strcpy() */
+                       random(), initstate() */
+#include <string.h> /* strcmp() */
 #include <unistd.h> /* getopt() */
+#ifdef FIRE_MPI
+#include <mpi.h> /* MPI_Init(), MPI_Comm_rank(), MPI_Finalize() */
+#endif
+#include "fire-serial.h" /* TREE_MAP(), NEW_TREE_MAP(), shared globals */
+#include "fire-rng.h" /* CounterRowKey(), CounterCatchesFire(),
+                           CounterFirstTree() */
+#include "fire-output.h" /* WriteTextFrame() */
 
 /* Define descriptions of command line options */
 #define N_ROWS_DESCR \
@@ -39,6 +47,72 @@
   "Filename to output tree data at each time step (file must not already exist)"
 #define IS_RAND_FIRST_TREE_DESCR \
   "Start the first on a random first tree as opposed to the middle tree"
+#define ENGINE_DESCR \
+  "How to advance the forest each time step:\n" \
+  "\t  serial   - one thread, one pass over the forest per phase\n" \
+  "\t  parallel - OpenMP threads (set OMP_NUM_THREADS); implies -k\n" \
+  "\t  frontier - only visit burning trees and their neighbors, and stop\n" \
+  "\t             once no tree is burning\n" \
+  "\t  fused    - one sweep per time step, swapping two padded forests\n" \
+  "\t  simd     - like fused, but 8 or 16 trees at a time with AVX2 or\n" \
+  "\t             AVX-512 if the CPU has them (FIRE_SIMD=avx512, avx2 or\n" \
+  "\t             scalar forces one); implies -k\n" \
+  "\t  tiled    - like fused, but each cache-sized tile of the forest is\n" \
+  "\t             advanced -K time steps at once; implies -k\n" \
+  "\t  compact  - like fused, but one byte per tree (needs -m below 256)\n" \
+  "\t  bitsliced - like fused, but each tree takes only as many bits as\n" \
+  "\t             -m needs, and 64 trees are updated at once (needs -m\n" \
+  "\t             below 256)\n" \
+  "\t  wavefront - compute each tree from its distance to the first tree\n" \
+  "\t             instead of stepping (needs -b 100)\n" \
+  "\t  mpi      - split the rows among MPI ranks (fire-mpi only; implies -k)"
+#define IS_BINARY_OUTPUT_DESCR \
+  "Write the -o tree data as binary frames from a background thread; turn\n" \
+  "\tthem into text with fire-convert"
+#define ENSEMBLE_PROBS_DESCR \
+  "Run an ensemble of simulations over the burn probabilities LOW:HIGH:STEP\n" \
+  "\t(integers [0..100]) instead of -b, using every thread (and, in\n" \
+  "\tfire-mpi, every rank), and print the mean and standard deviation of\n" \
+  "\tthe percentage of trees burned"
+#define N_ENSEMBLE_SEEDS_DESCR \
+  "Run an ensemble with this many seeds per burn probability, counting up\n" \
+  "\tfrom -s (positive integer)"
+#define CHECKPOINT_FILENAME_DESCR \
+  "Filename to write a checkpoint to every -I time steps, in the background\n" \
+  "\t(not with the compact, bitsliced or mpi engines)"
+#define CHECKPOINT_INTERVAL_DESCR \
+  "Time steps between checkpoints (positive integer)"
+#define RESTART_FILENAME_DESCR \
+  "Checkpoint file to restart from; the forest, parameters and engine all\n" \
+  "\tcome from the checkpoint"
+#define PROFILE_FILENAME_DESCR \
+  "Filename to write the time (and hardware counts, where allowed) of each\n" \
+  "\tphase of each time step to; JSON if it ends in .json, else CSV"
+#define N_TILE_STEPS_DESCR \
+  "Time steps each tile is advanced at once with the tiled engine (positive\n" \
+  "\tinteger)"
+#define STATS_FILENAME_DESCR \
+  "Filename to write statistics of the fire at each time step to, as CSV:\n" \
+  "\tburning and burnt out trees, fire front, bounding box and spread rate"
+#define MAP_FILENAME_DESCR \
+  "Map file giving each tree its own burn probability, burn steps and wind\n" \
+  "\t(see fire-map.c); -r, -c, -b and -m come from the map (serial and\n" \
+  "\tfused engines only)"
+#define STENCIL_DESCR \
+  "Which trees around a tree can catch it on fire (serial and fused\n" \
+  "\tengines only):\n" \
+  "\t  vonneumann  - the 4 nearest trees\n" \
+  "\t  moore       - the 8 trees around it\n" \
+  "\t  vonneumann2 - the trees at most 2 steps north, east, south and west\n" \
+  "\t  moore2      - the 5x5 square around it\n" \
+  "\t  vonneumann3 - the trees at most 3 steps away\n" \
+  "\t  moore3      - the 7x7 square around it"
+#define FRAME_INTERVAL_DESCR \
+  "Write -o tree data only every this many time steps (positive integer)"
+#define IS_COUNTER_RAND_DESCR \
+  "Use random numbers keyed on (seed, step, row, col), which give the same\n" \
+  "\tresult for any engine and number of threads; -f draws its tree the\n" \
+  "\tsame way"
 
 /* Define default values for simulation parameters - each of these parameters
    can also be changed later via user input */
@@ -50,6 +124,20 @@
 #define RAND_SEED_DEFAULT 1
 #define DEFAULT_IS_OUTPUTTING_EACH_STEP false
 #define DEFAULT_IS_RAND_FIRST_TREE false
+#ifdef FIRE_MPI
+#define ENGINE_DEFAULT ENGINE_MPI
+#else
+#define ENGINE_DEFAULT ENGINE_SERIAL
+#endif
+#define DEFAULT_IS_COUNTER_RAND false
+#define DEFAULT_IS_BINARY_OUTPUT false
+#define DEFAULT_IS_ENSEMBLE false
+#define N_ENSEMBLE_SEEDS_DEFAULT 1
+#define DEFAULT_IS_CHECKPOINTING false
+#define CHECKPOINT_INTERVAL_DEFAULT 100
+#define N_TILE_STEPS_DEFAULT 8
+#define FRAME_INTERVAL_DEFAULT 1
+#define STENCIL_DEFAULT "vonneumann"
 
 /* Define characters used on the command line to change the values of input
    parameters */
@@ -61,6 +149,20 @@
 #define RAND_SEED_CHAR 's'
 #define OUTPUT_FILENAME_CHAR 'o'
 #define IS_RAND_FIRST_TREE_CHAR 'f'
+#define ENGINE_CHAR 'e'
+#define IS_COUNTER_RAND_CHAR 'k'
+#define IS_BINARY_OUTPUT_CHAR 'B'
+#define ENSEMBLE_PROBS_CHAR 'P'
+#define N_ENSEMBLE_SEEDS_CHAR 'N'
+#define CHECKPOINT_FILENAME_CHAR 'C'
+#define CHECKPOINT_INTERVAL_CHAR 'I'
+#define RESTART_FILENAME_CHAR 'R'
+#define PROFILE_FILENAME_CHAR 'T'
+#define N_TILE_STEPS_CHAR 'K'
+#define STATS_FILENAME_CHAR 'S'
+#define FRAME_INTERVAL_CHAR 'F'
+#define STENCIL_CHAR 'n'
+#define MAP_FILENAME_CHAR 'M'
 
 /* Define options string used by getopt() - a colon after the character means
    the parameter's value is specified by the user */
@@ -72,18 +174,53 @@ const char GETOPT_STRING[] = {
   N_STEPS_CHAR, ':',
   RAND_SEED_CHAR, ':',
   OUTPUT_FILENAME_CHAR, ':',
-  IS_RAND_FIRST_TREE_CHAR
+  IS_RAND_FIRST_TREE_CHAR,
+  ENGINE_CHAR, ':',
+  IS_COUNTER_RAND_CHAR,
+  IS_BINARY_OUTPUT_CHAR,
+  ENSEMBLE_PROBS_CHAR, ':',
+  N_ENSEMBLE_SEEDS_CHAR, ':',
+  CHECKPOINT_FILENAME_CHAR, ':',
+  CHECKPOINT_INTERVAL_CHAR, ':',
+  RESTART_FILENAME_CHAR, ':',
+  PROFILE_FILENAME_CHAR, ':',
+  N_TILE_STEPS_CHAR, ':',
+  STATS_FILENAME_CHAR, ':',
+  FRAME_INTERVAL_CHAR, ':',
+  STENCIL_CHAR, ':',
+  MAP_FILENAME_CHAR, ':',
+  '\0'
 };
 
-/* Define a mapping from the row and column of a given tree in a forest with
-   boundaries to the index of that tree in a 1D array that includes
-   boundaries */
-#define TREE_MAP(row, col, nColsPlusBounds) ((row) * (nColsPlusBounds) + (col))
+/* Define the engines that can advance the forest each time step, in the
+   same order as ENGINE_NAMES */
+enum Engine {
+  ENGINE_SERIAL,
+  ENGINE_PARALLEL,
+  ENGINE_FRONTIER,
+  ENGINE_FUSED,
+  ENGINE_SIMD,
+  ENGINE_TILED,
+  ENGINE_COMPACT,
+  ENGINE_BITSLICED,
+  ENGINE_WAVEFRONT,
+  ENGINE_MPI,
+  N_ENGINES
+};
 
-/* Define a mapping from the row and column of a given tree in a forest with
-   boundaries to the index of that tree in a 1D array that does not include
-   boundaries */
-#define NEW_TREE_MAP(row, col, nCols) ((row - 1) * (nCols) + (col - 1))
+/* Define the names used on the command line to select each engine */
+const char *ENGINE_NAMES[N_ENGINES] = {
+  "serial",
+  "parallel",
+  "frontier",
+  "fused",
+  "simd",
+  "tiled",
+  "compact",
+  "bitsliced",
+  "wavefront",
+  "mpi"
+};
 
 /* Declare global parameters */
 int NRows = N_ROWS_DEFAULT;
@@ -94,21 +231,44 @@ int NSteps = N_STEPS_DEFAULT;
 int RandSeed = RAND_SEED_DEFAULT;
 bool IsOutputtingEachStep = DEFAULT_IS_OUTPUTTING_EACH_STEP;
 bool IsRandFirstTree = DEFAULT_IS_RAND_FIRST_TREE;
+enum Engine SelectedEngine = ENGINE_DEFAULT;
+bool IsCounterRand = DEFAULT_IS_COUNTER_RAND;
+bool IsBinaryOutput = DEFAULT_IS_BINARY_OUTPUT;
+bool IsEnsemble = DEFAULT_IS_ENSEMBLE;
+int EnsembleLowProb;
+int EnsembleHighProb;
+int EnsembleProbStep = 0; /* 0 until -P is given */
+int NEnsembleSeeds = N_ENSEMBLE_SEEDS_DEFAULT;
+bool IsCheckpointing = DEFAULT_IS_CHECKPOINTING;
+char *CheckpointFilename;
+int CheckpointInterval = CHECKPOINT_INTERVAL_DEFAULT;
+char *RestartFilename = NULL; /* NULL unless restarting */
+char *ProfileFilename = NULL; /* NULL unless profiling */
+int NTileSteps = N_TILE_STEPS_DEFAULT;
+char *StatsFilename = NULL; /* NULL unless writing statistics */
+int FrameInterval = FRAME_INTERVAL_DEFAULT;
+bool IsWideStencil = false; /* Was a neighborhood other than the default
+                               chosen with -n? */
+char *MapFilename = NULL; /* NULL unless every tree is the same */
 char *OutputFilename;
 
 /* Declare other needed global variables */
 bool AreParamsValid = true; /* Do the model parameters have valid values? */
-int NTrees; /* Total number of trees in the forest */
+int64_t NTrees; /* Total number of trees in the forest */
 int NRowsPlusBounds; /* Number of rows of trees plus the boundary rows */
 int NColsPlusBounds; /* Number of columns of trees plus the boundary columns */
-int NTreesPlusBounds; /* Total number of trees plus the boundaries */
+int64_t NTreesPlusBounds; /* Total number of trees plus the boundaries */
+int NBounds = 1; /* Width of the boundary, the radius of the neighborhood */
 int MiddleRow; /* The tree in the middle is here. If an even number of rows,
                   this tree is just below the middle */
 int MiddleCol; /* The tree in the middle is here. If an even number of cols,
                   this tree is just to the right of the middle */
 int CurStep; /* The current time step */
-int NBurnedTrees; /* The total number of burned trees */
-char ExeName[32]; /* The name of the program executable */
+int64_t NBurnedTrees; /* The total number of burned trees */
+const char *ExeName; /* The name of the program executable */
+int Rank = 0; /* The MPI rank of this process, or 0 without MPI */
+uint32_t RandState[RAND_STATE_WORDS]; /* State of random(), kept here so it
+                                         can be checkpointed */
 int NMaxBurnStepsDigits; /* The number of digits in the max burn steps; used for
                             outputting tree data */
 int *Trees; /* 1D tree array, contains a boundary around the outside of the
@@ -116,7 +276,8 @@ int *Trees; /* 1D tree array, contains a boundary around the outside of the
                all cells */
 int *NewTrees; /* Copy of 1D tree array - used so that we don't update the
                   forest too soon as we are deciding which new trees
-                  should burn -- does not contain boundary */
+                  should burn -- does not contain boundary, except with the
+                  fused, simd and tiled engines */
 FILE *OutputFile; /* For outputting tree data to a file */
 
 /* DECLARE FUNCTIONS */
@@ -142,6 +303,18 @@ void DescribeOptionNoDefault(const char optChar, const char *optDescr) {
   fprintf(stderr, "-%c : \n\t%s\n", optChar, optDescr);
 }
 
+/* Prints out a description of a command line option that takes a name
+
+   @param optChar The character used to specify the option
+   @param optDescr The description of the option
+   @param optDefault The default value of the option
+   */
+void DescribeOptionString(const char optChar, const char *optDescr,
+    const char *optDefault) {
+  fprintf(stderr, "-%c : \n\t%s\n\tdefault: %s\n", optChar, optDescr,
+      optDefault);
+}
+
 /* Print an error message
 
    @param errorMsg Buffer containing the message
@@ -170,6 +343,26 @@ void PrintUsageAndExit() {
   DescribeOptionNoDefault(OUTPUT_FILENAME_CHAR, OUTPUT_FILENAME_DESCR);
   DescribeOptionNoDefault(IS_RAND_FIRST_TREE_CHAR,
       IS_RAND_FIRST_TREE_DESCR);
+  DescribeOptionString(ENGINE_CHAR, ENGINE_DESCR,
+      ENGINE_NAMES[ENGINE_DEFAULT]);
+  DescribeOptionNoDefault(IS_COUNTER_RAND_CHAR, IS_COUNTER_RAND_DESCR);
+  DescribeOptionNoDefault(IS_BINARY_OUTPUT_CHAR, IS_BINARY_OUTPUT_DESCR);
+  DescribeOptionNoDefault(ENSEMBLE_PROBS_CHAR, ENSEMBLE_PROBS_DESCR);
+  DescribeOptionInt(N_ENSEMBLE_SEEDS_CHAR, N_ENSEMBLE_SEEDS_DESCR,
+      N_ENSEMBLE_SEEDS_DEFAULT);
+  DescribeOptionNoDefault(CHECKPOINT_FILENAME_CHAR,
+      CHECKPOINT_FILENAME_DESCR);
+  DescribeOptionInt(CHECKPOINT_INTERVAL_CHAR, CHECKPOINT_INTERVAL_DESCR,
+      CHECKPOINT_INTERVAL_DEFAULT);
+  DescribeOptionNoDefault(RESTART_FILENAME_CHAR, RESTART_FILENAME_DESCR);
+  DescribeOptionNoDefault(PROFILE_FILENAME_CHAR, PROFILE_FILENAME_DESCR);
+  DescribeOptionInt(N_TILE_STEPS_CHAR, N_TILE_STEPS_DESCR,
+      N_TILE_STEPS_DEFAULT);
+  DescribeOptionNoDefault(STATS_FILENAME_CHAR, STATS_FILENAME_DESCR);
+  DescribeOptionInt(FRAME_INTERVAL_CHAR, FRAME_INTERVAL_DESCR,
+      FRAME_INTERVAL_DEFAULT);
+  DescribeOptionString(STENCIL_CHAR, STENCIL_DESCR, STENCIL_DEFAULT);
+  DescribeOptionNoDefault(MAP_FILENAME_CHAR, MAP_FILENAME_DESCR);
   exit(EXIT_FAILURE);
 }
 
@@ -262,6 +455,77 @@ void AssertFileDNE(const char *filename) {
 }
 
 
+/* Find the engine with a given name. If there is none, print an error
+   message.
+
+   @param name The name of the engine given by the user
+   @return The engine, or ENGINE_DEFAULT if the name is unknown
+   */
+enum Engine ParseEngine(const char *name) {
+  char errorStr[64];
+  int engine;
+
+  for (engine = 0; engine < N_ENGINES; engine++) {
+    if (strcmp(name, ENGINE_NAMES[engine]) == 0) {
+      return (enum Engine)engine;
+    }
+  }
+
+  snprintf(errorStr, sizeof(errorStr),
+      "ERROR: unknown engine '%s' for -%c\n", name, ENGINE_CHAR);
+  PrintError(errorStr);
+  return ENGINE_DEFAULT;
+}
+
+/* Read a range of burn probabilities for an ensemble. If it is not valid,
+   print an error message.
+
+   @param range The range given by the user, as LOW:HIGH:STEP
+   */
+void ParseEnsembleProbs(const char *range) {
+  if (sscanf(range, "%d:%d:%d", &EnsembleLowProb, &EnsembleHighProb,
+        &EnsembleProbStep) != 3) {
+    PrintError("ERROR: value for -P must be LOW:HIGH:STEP\n");
+    return;
+  }
+  AssertBetweenInclusive(EnsembleLowProb, 0, 100, ENSEMBLE_PROBS_CHAR);
+  AssertBetweenInclusive(EnsembleHighProb, EnsembleLowProb, 100,
+      ENSEMBLE_PROBS_CHAR);
+  AssertBigger(EnsembleProbStep, 0, ENSEMBLE_PROBS_CHAR);
+}
+
+/* Choose the neighborhood with a given name, widening the boundary to its
+   radius. If there is none, print an error message.
+
+   @param name The name of the neighborhood given by the user
+   */
+void ParseStencil(const char *name) {
+  char errorStr[64];
+
+  IsWideStencil = strcmp(name, STENCIL_DEFAULT) != 0;
+  NBounds = IsWideStencil ? SelectStencil(name) : 1;
+  if (NBounds == 0) {
+    snprintf(errorStr, sizeof(errorStr),
+        "ERROR: unknown neighborhood '%s' for -%c\n", name, STENCIL_CHAR);
+    PrintError(errorStr);
+    NBounds = 1;
+  }
+}
+
+/* Return whether the selected engine stores trees in fire-compact.c rather
+   than in Trees */
+bool IsCompactEngine() {
+  return SelectedEngine == ENGINE_COMPACT ||
+    SelectedEngine == ENGINE_BITSLICED;
+}
+
+/* Return whether the selected engine keeps the forest in Trees and NewTrees
+   allocated by AllocateMemory(), rather than in its own storage or none */
+bool IsTreeArrayEngine() {
+  return !IsCompactEngine() && SelectedEngine != ENGINE_MPI &&
+    SelectedEngine != ENGINE_WAVEFRONT;
+}
+
 /* Allow the user to change simulation parameters via the command line
 
    @param argc The number of command line arguments to parse
@@ -306,6 +570,55 @@ void GetUserOptions(const int argc, char **argv) {
       case IS_RAND_FIRST_TREE_CHAR:
         IsRandFirstTree = true;
         break;
+      case ENGINE_CHAR:
+        SelectedEngine = ParseEngine(optarg);
+        break;
+      case IS_COUNTER_RAND_CHAR:
+        IsCounterRand = true;
+        break;
+      case IS_BINARY_OUTPUT_CHAR:
+        IsBinaryOutput = true;
+        break;
+      case ENSEMBLE_PROBS_CHAR:
+        IsEnsemble = true;
+        ParseEnsembleProbs(optarg);
+        break;
+      case N_ENSEMBLE_SEEDS_CHAR:
+        IsEnsemble = true;
+        NEnsembleSeeds = atoi(optarg);
+        AssertPositiveInteger(NEnsembleSeeds, N_ENSEMBLE_SEEDS_CHAR);
+        break;
+      case CHECKPOINT_FILENAME_CHAR:
+        IsCheckpointing = true;
+        CheckpointFilename = optarg;
+        break;
+      case CHECKPOINT_INTERVAL_CHAR:
+        CheckpointInterval = atoi(optarg);
+        AssertPositiveInteger(CheckpointInterval, CHECKPOINT_INTERVAL_CHAR);
+        break;
+      case RESTART_FILENAME_CHAR:
+        RestartFilename = optarg;
+        break;
+      case PROFILE_FILENAME_CHAR:
+        ProfileFilename = optarg;
+        break;
+      case N_TILE_STEPS_CHAR:
+        NTileSteps = atoi(optarg);
+        AssertPositiveInteger(NTileSteps, N_TILE_STEPS_CHAR);
+        break;
+      case STATS_FILENAME_CHAR:
+        StatsFilename = optarg;
+        break;
+      case FRAME_INTERVAL_CHAR:
+        FrameInterval = atoi(optarg);
+        AssertPositiveInteger(FrameInterval, FRAME_INTERVAL_CHAR);
+        break;
+      case STENCIL_CHAR:
+        ParseStencil(optarg);
+        break;
+      case MAP_FILENAME_CHAR:
+        MapFilename = optarg;
+        break;
       case '?':
       default:
         PrintError("ERROR: illegal option\n");
@@ -317,12 +630,109 @@ void GetUserOptions(const int argc, char **argv) {
     /* Make sure the output file does not exist (DNE) */
     AssertFileDNE(OutputFilename);
   }
+
+  if (SelectedEngine == ENGINE_PARALLEL || SelectedEngine == ENGINE_MPI ||
+      SelectedEngine == ENGINE_SIMD || SelectedEngine == ENGINE_TILED) {
+    /* Threads, ranks, SIMD lanes and tiles cannot share random(), so use
+       the counter-based generator */
+    IsCounterRand = true;
+  }
+
+  if (IsEnsemble) {
+    if (EnsembleProbStep == 0) {
+      /* No -P, so sweep only the seeds */
+      EnsembleLowProb = EnsembleHighProb = BurnProb;
+      EnsembleProbStep = 1;
+    }
+    if (IsOutputtingEachStep) {
+      PrintError("ERROR: an ensemble cannot output tree data\n");
+    }
+    if (ProfileFilename != NULL) {
+      PrintError("ERROR: an ensemble cannot be profiled\n");
+    }
+    if (StatsFilename != NULL) {
+      PrintError("ERROR: an ensemble cannot write statistics\n");
+    }
+  }
+
+  if (SelectedEngine == ENGINE_WAVEFRONT && BurnProb != 100) {
+    PrintError("ERROR: the wavefront engine needs -b 100\n");
+  }
+
+  if ((IsCheckpointing || RestartFilename != NULL) &&
+      (IsEnsemble || IsCompactEngine() || SelectedEngine == ENGINE_MPI ||
+       SelectedEngine == ENGINE_WAVEFRONT)) {
+    /* Only Trees and NewTrees are checkpointed */
+    PrintError("ERROR: this engine cannot checkpoint or restart\n");
+  }
+
+  if (SelectedEngine == ENGINE_MPI) {
+#ifndef FIRE_MPI
+    PrintError("ERROR: the mpi engine needs fire-mpi (make fire-mpi)\n");
+#endif
+    if (IsOutputtingEachStep || StatsFilename != NULL) {
+      /* No rank holds the whole forest */
+      PrintError("ERROR: the mpi engine cannot output tree data or "
+          "statistics\n");
+    }
+  }
+
+  if (IsWideStencil) {
+    if (IsEnsemble || (SelectedEngine != ENGINE_SERIAL &&
+          SelectedEngine != ENGINE_FUSED)) {
+      PrintError("ERROR: only the serial and fused engines support -n\n");
+    }
+    if (IsCheckpointing || RestartFilename != NULL) {
+      /* Checkpoints only have a boundary of one tree */
+      PrintError("ERROR: -n cannot be used to checkpoint or restart\n");
+    }
+  }
+
+  if (MapFilename != NULL) {
+    if (IsEnsemble || (SelectedEngine != ENGINE_SERIAL &&
+          SelectedEngine != ENGINE_FUSED)) {
+      PrintError("ERROR: only the serial and fused engines support -M\n");
+    }
+    if (IsWideStencil) {
+      /* The wind only blows from the 4 nearest trees */
+      PrintError("ERROR: -M cannot be used with -n\n");
+    }
+    if (IsCheckpointing || RestartFilename != NULL) {
+      /* Checkpoints do not record the map */
+      PrintError("ERROR: -M cannot be used to checkpoint or restart\n");
+    }
+  }
+
+  if (IsCompactEngine()) {
+    /* Make sure a tree's state fits in a byte */
+    AssertBetweenInclusive(NMaxBurnSteps, 2, 255, N_MAX_BURN_STEPS_CHAR);
+  }
+}
+
+/* Return the number of trees in NewTrees, which only has a boundary with
+   engines that swap it with Trees */
+int64_t NNewTrees() {
+  return SelectedEngine == ENGINE_FUSED || SelectedEngine == ENGINE_SIMD ||
+    SelectedEngine == ENGINE_TILED ?
+    NTreesPlusBounds : NTrees;
 }
 
-/* Allocate dynamic memory */
+/* Allocate dynamic memory, on huge pages if possible; InitData() places
+   the pages. Padded forests point BOUNDS_SHIFT() trees past the start of
+   their memory, so row 1, column 1 is at TREE_MAP(1, 1, ...) for any width
+   of boundary */
 void AllocateMemory() {
-  Trees    = (int*)malloc(NTreesPlusBounds * sizeof(int));
-  NewTrees = (int*)malloc(          NTrees * sizeof(int));
+  const int64_t shift = BOUNDS_SHIFT(NBounds, NColsPlusBounds);
+  const bool isNewTreesPadded = NNewTrees() == NTreesPlusBounds;
+
+  Trees    = (int*)AllocateForest(NTreesPlusBounds * sizeof(int));
+  NewTrees = (int*)AllocateForest(NNewTrees() * sizeof(int));
+  if (Trees == NULL || NewTrees == NULL) {
+    fprintf(stderr, "ERROR: out of memory for the forest\n");
+    exit(EXIT_FAILURE);
+  }
+  Trees += shift;
+  NewTrees += isNewTreesPadded ? shift : 0;
 }
 
 /* Generate a random integer between [min..max)
@@ -335,71 +745,132 @@ int RandBetween(const int min, const int max) {
   return min + (random() % (max - min));
 }
 
+/* Return whether a tree next to a burning tree catches fire, using the
+   generator chosen by the user
+
+   @param row The row index of the tree
+   @param col The column index of the tree
+   @return Whether the tree catches fire
+   */
+bool CatchesFire(const int row, const int col) {
+  return CatchesFireWithChance(row, col, BurnProb);
+}
+
+/* Return whether a tree next to a burning tree catches fire with a given
+   chance, using the generator chosen by the user
+
+   @param row The row index of the tree
+   @param col The column index of the tree
+   @param percent The chance, as an integer percent
+   @return Whether the tree catches fire
+   */
+bool CatchesFireWithChance(const int row, const int col, const int percent) {
+  if (IsCounterRand) {
+    return CounterCatchesFire(CounterRowKey(RandSeed, CurStep, row), col,
+        CounterThreshold(percent));
+  }
+  return RandBetween(0, 100) < percent;
+}
+
+/* Choose the first tree to light on fire
+
+   @param row Set to the row index of the tree
+   @param col Set to the column index of the tree
+   */
+void ChooseFirstTree(int *row, int *col) {
+  if (IsRandFirstTree && IsCounterRand) {
+    /* Light a random tree on fire without touching random(), as the
+       ensemble does */
+    CounterFirstTree(RandSeed, NRows, NCols, row, col);
+  }
+  else if (IsRandFirstTree) {
+    /* Light a random tree on fire */
+    *row = RandBetween(1, NRows + 1);
+    *col = RandBetween(1, NCols + 1);
+  }
+  else {
+    /* Light the middle tree on fire */
+    *row = MiddleRow + 1;
+    *col = MiddleCol + 1;
+  }
+}
+
 /* Light a random tree on fire, set all other trees to be not burning */
 void InitData() {
+  const bool isNewTreesPadded = NNewTrees() == NTreesPlusBounds;
   int row;
   int col;
 
-  /* Set all trees as having burned for 0 time steps */
+  /* Set all trees as having burned for 0 time steps. This is the first
+     write to each page, and the kernel puts a page on the NUMA node of the
+     thread that first writes it, so split the rows among threads the same
+     way the parallel engine does */
+#pragma omp parallel for private(col) schedule(static)
   for (row = 1; row < NRows + 1; row++) {
     for (col = 1; col < NCols + 1; col++) {
-      Trees[         TREE_MAP(row, col, NColsPlusBounds)] =
-        NewTrees[NEW_TREE_MAP(row, col, NCols)]           = 0;
+      Trees[TREE_MAP(row, col, NColsPlusBounds)] = 0;
+      if (isNewTreesPadded) {
+        NewTrees[TREE_MAP(row, col, NColsPlusBounds)] = 0;
+      }
+      else {
+        NewTrees[NEW_TREE_MAP(row, col, NCols)] = 0;
+      }
     }
   }
 
-  /* Set the boundaries as burnt out */
-  for (row = 0; row < NRowsPlusBounds; row++) {
-    /* Left */
-    Trees[TREE_MAP(row, 0, NColsPlusBounds)] = NMaxBurnSteps;
-
-    /* Top/Bottom */
-    if ((row == 0) || (row == NRows + 1)) {
-      for (col = 1; col < NCols + 1; col++) {
+  /* Set the boundaries, NBounds trees wide, as burnt out */
+  for (row = 1 - NBounds; row < NRows + 1 + NBounds; row++) {
+    for (col = 1 - NBounds; col < NCols + 1 + NBounds; col++) {
+      /* Top/Bottom rows, and the Left/Right columns of every other row */
+      if (row < 1 || row > NRows || col < 1 || col > NCols) {
         Trees[TREE_MAP(row, col, NColsPlusBounds)] = NMaxBurnSteps;
       }
+      else {
+        /* Jump over the trees */
+        col = NCols;
+      }
     }
-
-    /* Right */
-    Trees[TREE_MAP(row, NCols + 1, NColsPlusBounds)] = NMaxBurnSteps;
   }
 
-  if (IsRandFirstTree) {
-    /* Light a random tree on fire */
-    row = RandBetween(1, NRows + 1);
-    col = RandBetween(1, NCols + 1);
-  }
-  else {
-    /* Light the middle tree on fire */
-    row = MiddleRow + 1;
-    col = MiddleCol + 1;
-  }
+  ChooseFirstTree(&row, &col);
   Trees[         TREE_MAP(row, col, NColsPlusBounds)] =
     NewTrees[NEW_TREE_MAP(row, col, NCols)]           = 1;
   NBurnedTrees++;
 }
 
-/* Output tree data for the current time step */
-void OutputData() {
-  int row;
-  int col;
-  char buf[64];
+/* Return the state of a tree, wherever the selected engine stores it
 
-  /* Write the header for the current time step */
-  sprintf(buf, "Time step %d\n", CurStep);
-  fprintf(OutputFile, "%s", buf);
-
-  for (row = 1; row < NRows + 1; row++) {
-    for (col = 1; col < NCols + 1; col++) {
-      sprintf(buf, "%*d ",
-          NMaxBurnStepsDigits, Trees[TREE_MAP(row, col, NColsPlusBounds)]);
-      fprintf(OutputFile, "%s", buf);
-    }
-    fprintf(OutputFile, "\n");
+   @param row The row index of the tree
+   @param col The column index of the tree
+   @return The number of time steps the tree has burned
+   */
+int GetTreeState(const int row, const int col) {
+  if (IsCompactEngine()) {
+    return CompactTreeState(row, col);
   }
+  if (SelectedEngine == ENGINE_WAVEFRONT) {
+    return WavefrontTreeState(row, col);
+  }
+  return Trees[TREE_MAP(row, col, NColsPlusBounds)];
+}
+
+/* GetTreeState() for WriteTextFrame(), which counts rows and columns
+   from 0
+
+   @param row The row index of the tree, from 0
+   @param col The column index of the tree, from 0
+   @param context Unused
+   @return The number of time steps the tree has burned
+   */
+static int GetTextTreeState(int row, int col, const void *context) {
+  (void)context;
+  return GetTreeState(row + 1, col + 1);
+}
 
-  /* Write the newline between time steps */
-  fprintf(OutputFile, "\n");
+/* Output tree data for the current time step */
+void OutputData() {
+  WriteTextFrame(OutputFile, CurStep, NRows, NCols, NMaxBurnStepsDigits,
+      GetTextTreeState, NULL);
 }
 
 /* Return whether a given tree has burnt out
@@ -424,9 +895,10 @@ bool IsOnFire(const int row, const int col) {
 }
 
 /* For trees already burning, increment the number of time steps they have
-   burned 
+   burned, counting burning and burnt out trees in CurStats with -S
    */
 void ContinueBurning() {
+  const bool isMeasuring = StatsFilename != NULL;
   int row;
   int col;
 
@@ -435,32 +907,64 @@ void ContinueBurning() {
       if (IsOnFire(row, col)) {
         NewTrees[NEW_TREE_MAP(row, col, NCols)] =
           Trees[     TREE_MAP(row, col, NColsPlusBounds)] + 1;
+
+        if (isMeasuring) {
+          CurStats.nBurning++;
+          AddToBoundingBox(&CurStats, row, col);
+        }
+      }
+      else if (isMeasuring && IsBurntOut(row, col)) {
+        CurStats.nBurntOut++;
+        AddToBoundingBox(&CurStats, row, col);
       }
     }
   }
 }
 
 /* Find trees that are not on fire yet and try to catch them on fire from
-   burning neighbor trees
+   burning neighbor trees, adding up the fire front in CurStats with -S
    */
 void BurnNew() {
+  const bool isMeasuring = StatsFilename != NULL;
   int row;
   int col;
 
   for (row = 1; row < NRows + 1; row++) {
     for (col = 1; col < NCols + 1; col++) {
       if (!IsOnFire(row, col) && !IsBurntOut(row, col)) {
+        int nBurningNeighbors;
+
         /* Check neighbors */
-        /* Top */
-        if ((IsOnFire(row-1, col) ||
-              /* Left */
-              IsOnFire(row, col-1) ||
-              /* Bottom */
-              IsOnFire(row+1, col) ||
-              /* Right */
-              IsOnFire(row, col+1)) &&
+        if (isMeasuring) {
+          /* Count them all: each burning neighbor is an edge of the fire
+             front */
+          nBurningNeighbors =
+            /* Top */
+            IsOnFire(row-1, col) +
+            /* Left */
+            IsOnFire(row, col-1) +
+            /* Bottom */
+            IsOnFire(row+1, col) +
+            /* Right */
+            IsOnFire(row, col+1);
+          CurStats.perimeter += nBurningNeighbors;
+        }
+        else {
+          /* Stop at the first */
+          nBurningNeighbors =
+            /* Top */
+            IsOnFire(row-1, col) ||
+            /* Left */
+            IsOnFire(row, col-1) ||
+            /* Bottom */
+            IsOnFire(row+1, col) ||
+            /* Right */
+            IsOnFire(row, col+1);
+        }
+
+        if (nBurningNeighbors > 0 &&
             /* Apply random chance */
-            (RandBetween(0, 100) < BurnProb)) {
+            CatchesFire(row, col)) {
           /* Catch the tree on fire */
           NewTrees[NEW_TREE_MAP(row, col, NCols)] = 1;
 
@@ -486,16 +990,118 @@ void AdvanceTime() {
 
 /* Free allocated memory */
 void FreeMemory() {
-  free(NewTrees);
-  free(Trees);
+  const int64_t shift = BOUNDS_SHIFT(NBounds, NColsPlusBounds);
+
+  FreeForest(NewTrees - (NNewTrees() == NTreesPlusBounds ? shift : 0),
+      NNewTrees() * sizeof(int));
+  FreeForest(Trees - shift, NTreesPlusBounds * sizeof(int));
+}
+
+/* Return whether the selected engine adds up the statistics of the forest
+   as it steps, rather than needing SweepStats()
+
+   @return Whether it does
+   */
+bool IsEngineMeasuring() {
+  switch (SelectedEngine) {
+    case ENGINE_SERIAL:
+    case ENGINE_PARALLEL:
+    case ENGINE_TILED:
+    case ENGINE_WAVEFRONT:
+      return true;
+    case ENGINE_FUSED:
+      return MapFilename == NULL && !IsWideStencil;
+    default:
+      return false;
+  }
+}
+
+/* Advance the forest by one time step with any engine but the serial one,
+   which main() times phase by phase
+
+   @param stats Statistics for the engine to add the forest before the time
+     step to, or NULL
+   */
+void StepEngine(struct ForestStats *stats) {
+  switch (SelectedEngine) {
+    case ENGINE_PARALLEL:
+      /* Do all three phases with every thread */
+      StepParallel(stats);
+      break;
+    case ENGINE_FRONTIER:
+      /* Only visit burning trees and their neighbors */
+      StepFrontier();
+      break;
+    case ENGINE_FUSED:
+      /* Do all three phases in one sweep, with the chosen neighborhood or
+         map */
+      if (MapFilename != NULL) {
+        StepFusedMap();
+      }
+      else if (IsWideStencil) {
+        StepFusedStencil();
+      }
+      else {
+        StepFused(stats);
+      }
+      break;
+    case ENGINE_SIMD:
+      /* Do all three phases in one sweep, many trees at a time */
+      StepSimd();
+      break;
+    case ENGINE_COMPACT:
+    case ENGINE_BITSLICED:
+      /* Do all three phases in one sweep over the compact forest */
+      StepCompact();
+      break;
+    case ENGINE_MPI:
+#ifdef FIRE_MPI
+      /* Advance this rank's rows, exchanging edge rows with its neighbors */
+      StepMpi();
+#endif
+      break;
+    default:
+      break;
+  }
+}
+
+/* Return the number of time steps from the current one to the next one that
+   has to be seen - output, checkpointed, measured for statistics or the end
+   of the simulation - and at most MAX_STATS_STEPS when writing statistics,
+   which the engine keeps for every time step it does
+
+   @return The number of time steps, at least 1
+   */
+int NStepsUntilStop() {
+  int nSteps = NSteps - CurStep;
+
+  if (IsOutputtingEachStep &&
+      FrameInterval - CurStep % FrameInterval < nSteps) {
+    nSteps = FrameInterval - CurStep % FrameInterval;
+  }
+  if (StatsFilename != NULL && nSteps > MAX_STATS_STEPS) {
+    nSteps = MAX_STATS_STEPS;
+  }
+  if (IsCheckpointing &&
+      CheckpointInterval - CurStep % CheckpointInterval < nSteps) {
+    nSteps = CheckpointInterval - CurStep % CheckpointInterval;
+  }
+  return nSteps;
 }
 
 /* @param argc The number of command line arguments
    @param argv String of command line arguments
    */
 int main(int argc, char **argv) {
+  int64_t nCheckpointNewTrees = 0; /* Ints in NewTrees of the checkpoint */
+
+#ifdef FIRE_MPI
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &Rank);
+#endif
+
   /* Set the program executable name */
-  strcpy(ExeName, argv[0]);
+  ExeName = argv[0];
 
   /* Allow the user to change simulation parameters via the command line */
   GetUserOptions(argc, argv);
@@ -505,61 +1111,309 @@ int main(int argc, char **argv) {
     PrintUsageAndExit();
   }
 
+  if (RestartFilename != NULL) {
+    int engine;
+
+    /* Take the parameters, trees and step to resume at from the
+       checkpoint */
+    MapCheckpoint(RestartFilename, N_ENGINES, &engine, &nCheckpointNewTrees);
+    SelectedEngine = (enum Engine)engine;
+  }
+  if (MapFilename != NULL) {
+    /* Take the size of the forest and the values of each tree from the
+       map */
+    MapRaster(MapFilename);
+  }
+
   if (IsOutputtingEachStep) {
     /* Open the output file */
-    OutputFile = fopen(OutputFilename, "w");
+    OutputFile = fopen(OutputFilename, IsBinaryOutput ? "wb" : "w");
   }
 
   /* Do some calculations before splitting up the rows */
-  NTrees = NRows * NCols;
-  NRowsPlusBounds = NRows + 2;
-  NColsPlusBounds = NCols + 2;
-  NTreesPlusBounds = NRowsPlusBounds * NColsPlusBounds;
+  NTrees = (int64_t)NRows * NCols;
+  NRowsPlusBounds = NRows + 2 * NBounds;
+  NColsPlusBounds = NCols + 2 * NBounds;
+  NTreesPlusBounds = (int64_t)NRowsPlusBounds * NColsPlusBounds;
   MiddleRow = NRows / 2;
   MiddleCol = NCols / 2;
 
-  /* Allocate dynamic memory for the 1D tree arrays */
-  AllocateMemory();
+  if (RestartFilename != NULL && nCheckpointNewTrees != NNewTrees()) {
+    /* The engine would index NewTrees past what the checkpoint holds */
+    fprintf(stderr, "ERROR: '%s' is not a checkpoint\n", RestartFilename);
+    exit(EXIT_FAILURE);
+  }
+
+  if (IsEnsemble) {
+    /* Run every burn probability and seed instead of a single simulation */
+    RunEnsemble(EnsembleLowProb, EnsembleHighProb, EnsembleProbStep,
+        RandSeed, NEnsembleSeeds, IsRandFirstTree);
+#ifdef FIRE_MPI
+    MPI_Finalize();
+#endif
+    return 0;
+  }
+
+  if (ProfileFilename != NULL && Rank == 0) {
+    /* Start timing; only rank 0 reports with the mpi engine */
+    StartProfile(ProfileFilename, ENGINE_NAMES[SelectedEngine]);
+  }
+  BeginPhase(PHASE_INIT);
 
-  /* Seed the random number generator */
-  srandom(RandSeed);
+  if (RestartFilename != NULL) {
+    /* Trees, NewTrees, NBurnedTrees and random() are already restored */
+  }
+  else {
+    /* Seed the random number generator, keeping its state in RandState */
+    initstate(RandSeed, (char*)RandState, sizeof(RandState));
 
-  /* Initialize number of burned trees */
-  NBurnedTrees = 0;
+    /* Initialize number of burned trees */
+    NBurnedTrees = 0;
 
-  /* Light a random tree on fire, set all other trees to be not burning */
-  InitData();
+    /* Start at the first time step */
+    CurStep = 0;
+  }
 
-  /* Start the simulation looping for the specified number of time steps */
-  for (CurStep = 0; CurStep < NSteps; CurStep++) {
-    if (IsOutputtingEachStep) {
-      /* Output tree data for the current time step */
-      OutputData();
+  if (RestartFilename != NULL) {
+    /* Nothing to allocate or initialize */
+  }
+  else if (SelectedEngine == ENGINE_MPI) {
+    int firstRow;
+    int firstCol;
+
+    /* Allocate only this rank's rows, then light a random tree on fire */
+    ChooseFirstTree(&firstRow, &firstCol);
+#ifdef FIRE_MPI
+    InitMpi(firstRow, firstCol);
+#endif
+  }
+  else if (IsCompactEngine()) {
+    int firstRow;
+    int firstCol;
+
+    /* Allocate the compact forests instead of the 1D tree arrays, then
+       light a random tree on fire */
+    AllocateCompact(SelectedEngine == ENGINE_BITSLICED);
+    ChooseFirstTree(&firstRow, &firstCol);
+    InitCompact(firstRow, firstCol);
+    NBurnedTrees++;
+  }
+  else if (SelectedEngine == ENGINE_WAVEFRONT) {
+    int firstRow;
+    int firstCol;
+
+    /* No forest to allocate; only remember where the fire starts */
+    ChooseFirstTree(&firstRow, &firstCol);
+    InitWavefront(firstRow, firstCol);
+    NBurnedTrees++;
+  }
+  else {
+    /* Every other engine, IsTreeArrayEngine(): allocate dynamic memory for
+       the 1D tree arrays */
+    AllocateMemory();
+
+    /* Light a random tree on fire, set all other trees to be not burning */
+    InitData();
+  }
+
+  if (SelectedEngine == ENGINE_FRONTIER) {
+    /* Find the trees that are already burning */
+    InitFrontier();
+  }
+  if (SelectedEngine == ENGINE_SIMD) {
+    /* Choose the instruction set */
+    InitSimd();
+  }
+  if ((SelectedEngine == ENGINE_FUSED || SelectedEngine == ENGINE_SIMD ||
+        SelectedEngine == ENGINE_TILED) && RestartFilename == NULL) {
+    /* Give NewTrees the same boundary as Trees */
+    InitFused();
+  }
+
+  if (IsOutputtingEachStep && IsBinaryOutput) {
+    /* Write the file header and start the writer thread */
+    OpenBinaryOutput(OutputFile);
+  }
+  if (StatsFilename != NULL) {
+    /* Write the header of the statistics */
+    OpenStats(StatsFilename);
+  }
+  EndPhase(PHASE_INIT);
+
+  /* Start the simulation looping for the specified number of time steps,
+     from the checkpointed step if restarting */
+  for (; CurStep < NSteps; CurStep++) {
+    int64_t nBurnedTreesBefore = NBurnedTrees;
+    /* Where the engine adds up the statistics as it steps, if it does */
+    struct ForestStats *engineStats = StatsFilename != NULL &&
+      IsEngineMeasuring() ? &CurStats : NULL;
+
+    if (IsCheckpointing && CurStep % CheckpointInterval == 0 &&
+        CurStep > 0) {
+      /* Save the simulation as of the start of this time step */
+      BeginPhase(PHASE_CHECKPOINT);
+      WriteCheckpoint(CheckpointFilename, SelectedEngine, NNewTrees());
+      EndPhase(PHASE_CHECKPOINT);
+    }
+
+    if (IsOutputtingEachStep && CurStep % FrameInterval == 0) {
+      BeginPhase(PHASE_OUTPUT);
+      if (IsBinaryOutput) {
+        /* Hand tree data for the current time step to the writer thread */
+        QueueBinaryFrame();
+      }
+      else {
+        /* Output tree data for the current time step */
+        OutputData();
+      }
+      EndPhase(PHASE_OUTPUT);
     }
 
-    /* For trees already burning, increment the number of time steps they have
-       burned */
-    ContinueBurning();
+    if (SelectedEngine == ENGINE_FRONTIER && !IsFrontierBurning() &&
+        !IsOutputtingEachStep && StatsFilename == NULL) {
+      /* No tree is burning, so no tree can change any more */
+      break;
+    }
 
-    /* Find trees that are not on fire yet and try to catch them on fire from
-       burning neighbor trees */
-    BurnNew();
+    if (StatsFilename != NULL && engineStats == NULL) {
+      /* Measure the forest before the engine advances it */
+      SweepStats();
+    }
+    else if (engineStats != NULL) {
+      /* The engine adds up the statistics as it goes */
+      ResetStats();
+    }
 
-    /* Copy new tree data into old tree data */
-    AdvanceTime();
+    if (SelectedEngine == ENGINE_SERIAL) {
+      /* For trees already burning, increment the number of time steps they
+         have burned */
+      BeginPhase(PHASE_CONTINUE_BURNING);
+      if (MapFilename != NULL) {
+        ContinueBurningMap();
+      }
+      else {
+        ContinueBurning();
+      }
+      EndPhase(PHASE_CONTINUE_BURNING);
+
+      /* Find trees that are not on fire yet and try to catch them on fire
+         from burning neighbor trees */
+      BeginPhase(PHASE_BURN_NEW);
+      if (MapFilename != NULL) {
+        BurnNewMap();
+      }
+      else if (IsWideStencil) {
+        BurnNewStencil();
+      }
+      else {
+        BurnNew();
+      }
+      EndPhase(PHASE_BURN_NEW);
+
+      /* Copy new tree data into old tree data */
+      BeginPhase(PHASE_ADVANCE_TIME);
+      AdvanceTime();
+      EndPhase(PHASE_ADVANCE_TIME);
+    }
+    else if (SelectedEngine == ENGINE_TILED ||
+        SelectedEngine == ENGINE_WAVEFRONT) {
+      struct ForestStats *stepStats = engineStats != NULL ? StepStats : NULL;
+      int nStepsDone;
+
+      /* Do several time steps at once, up to the next one to output,
+         checkpoint or stop keeping statistics for */
+      BeginPhase(PHASE_STEP);
+      nStepsDone = SelectedEngine == ENGINE_TILED ?
+        StepTiled(NStepsUntilStop(), stepStats, StepNewBurning) :
+        StepWavefront(NStepsUntilStop(), stepStats, StepNewBurning);
+      EndPhase(PHASE_STEP);
+
+      if (stepStats != NULL) {
+        /* Write the statistics of every time step done but the last, and
+           leave the last one for below */
+        WriteStepStats(CurStep, nStepsDone - 1, nBurnedTreesBefore);
+        CurStats = StepStats[nStepsDone - 1];
+        nBurnedTreesBefore = NBurnedTrees - StepNewBurning[nStepsDone - 1];
+      }
+      CurStep += nStepsDone - 1;
+    }
+    else {
+      /* Do all three phases with the selected engine */
+      BeginPhase(PHASE_STEP);
+      StepEngine(engineStats);
+      EndPhase(PHASE_STEP);
+    }
+
+    if (StatsFilename != NULL) {
+      /* Write the statistics of this time step */
+      WriteStats(CurStep, nBurnedTreesBefore,
+          NBurnedTrees - nBurnedTreesBefore);
+    }
+
+    /* Report the time of each phase of this time step */
+    EndProfileStep(CurStep);
   }
 
-  /* Print the total percentage of trees burned */
-  printf("%.2f%% of the trees were burned\n",
-      (100.0 * NBurnedTrees) / NTrees);
+  if (StatsFilename != NULL) {
+    /* Write the statistics of the final forest */
+    SweepStats();
+    WriteStats(CurStep, NBurnedTrees, 0);
+    CloseStats();
+  }
+
+#ifdef FIRE_MPI
+  if (SelectedEngine == ENGINE_MPI) {
+    /* Add up the trees burned by every rank */
+    ReduceMpi();
+  }
+#endif
+
+  if (Rank == 0) {
+    /* Print the total percentage of trees burned */
+    printf("%.2f%% of the trees were burned\n",
+        (100.0 * NBurnedTrees) / NTrees);
+  }
 
   if (IsOutputtingEachStep) {
+    if (IsBinaryOutput) {
+      /* Wait for the writer thread to finish */
+      BeginPhase(PHASE_OUTPUT);
+      CloseBinaryOutput();
+      EndPhase(PHASE_OUTPUT);
+    }
+
     /* Close the output file */
     fclose(OutputFile);
   }
 
+  /* Write the total time of each phase and close the report */
+  FinishProfile();
+
   /* Free allocated memory */
-  FreeMemory();
+  if (RestartFilename != NULL || IsCheckpointing) {
+    /* Finish the last checkpoint and unmap the one restarted from */
+    CloseCheckpoint();
+  }
+  if (RestartFilename == NULL && IsTreeArrayEngine()) {
+    /* Only what AllocateMemory() allocated; a checkpoint's trees are in
+       its mapping */
+    FreeMemory();
+  }
+  if (IsCompactEngine()) {
+    FreeCompact();
+  }
+  if (SelectedEngine == ENGINE_FRONTIER) {
+    FreeFrontier();
+  }
+  if (MapFilename != NULL) {
+    CloseRaster();
+  }
+#ifdef FIRE_MPI
+  if (SelectedEngine == ENGINE_MPI) {
+    FreeMpi();
+  }
+  MPI_Finalize();
+#endif
 
   return 0;
 }
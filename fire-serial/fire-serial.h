@@ -0,0 +1,242 @@
+/* Declarations shared between the files of the forest fire model - see
+   fire-serial.c for a description of the model */
+
+#ifndef FIRE_SERIAL_H
+#define FIRE_SERIAL_H
+
+#include <stdbool.h> /* bool type */
+#include <stdint.h> /* int64_t, uint32_t */
+#include <stdio.h> /* FILE */
+
+/* Define a mapping from the row and column of a given tree in a forest with
+   boundaries to the index of that tree in a 1D array that includes
+   boundaries; 64-bit, so forests may have more than 2^31 trees */
+#define TREE_MAP(row, col, nColsPlusBounds) \
+  ((int64_t)(row) * (nColsPlusBounds) + (col))
+
+/* Define how many trees past the start of its memory a forest with
+   boundaries NBounds trees wide starts, so that TREE_MAP() still puts the
+   top left tree at row 1, column 1 */
+#define BOUNDS_SHIFT(nBounds, nColsPlusBounds) \
+  ((int64_t)((nBounds) - 1) * ((nColsPlusBounds) + 1))
+
+/* Define a mapping from the row and column of a given tree in a forest with
+   boundaries to the index of that tree in a 1D array that does not include
+   boundaries */
+#define NEW_TREE_MAP(row, col, nCols) \
+  ((int64_t)((row) - 1) * (nCols) + ((col) - 1))
+
+/* Define the size of the state of random(), in 32-bit words */
+#define RAND_STATE_WORDS 32
+
+/* Declare global parameters */
+extern int NRows;
+extern int NCols;
+extern int BurnProb;
+extern int NMaxBurnSteps;
+extern int NSteps;
+extern int RandSeed;
+extern bool IsCounterRand;
+
+/* Declare other needed global variables */
+extern int64_t NTrees;
+extern int NRowsPlusBounds;
+extern int NColsPlusBounds;
+extern int64_t NTreesPlusBounds;
+extern int NBounds;
+extern int CurStep;
+extern int64_t NBurnedTrees;
+extern int *Trees;
+extern int *NewTrees;
+extern int Rank;
+extern uint32_t RandState[RAND_STATE_WORDS];
+extern int NMaxBurnStepsDigits;
+extern bool IsProfiling;
+extern int NTileSteps;
+
+/* Define the statistics of the forest at one time step (see fire-stats.c) */
+struct ForestStats {
+  int64_t nBurning; /* Trees on fire */
+  int64_t nBurntOut; /* Trees that have stopped burning */
+  int64_t perimeter; /* Edges between burning and unburned trees */
+  int minRow; /* Bounding box of the burning and burnt out trees */
+  int maxRow;
+  int minCol;
+  int maxCol;
+};
+extern struct ForestStats CurStats;
+
+/* Define the most time steps the tiled and wavefront engines do at once
+   while writing statistics, and the statistics of each of them and the
+   trees caught on fire during each (see fire-stats.c) */
+#define MAX_STATS_STEPS 64
+extern struct ForestStats StepStats[MAX_STATS_STEPS];
+extern int64_t StepNewBurning[MAX_STATS_STEPS];
+
+/* Define the state of one simulation that StepForestRun() advances: the
+   fused engine wraps the global forest in one, and the ensemble keeps one
+   per thread and reuses it for every run */
+struct ForestRun {
+  int *trees; /* Padded forest, NRowsPlusBounds x NColsPlusBounds */
+  int *newTrees; /* Same layout, for the next time step */
+  bool isCounterRand; /* Draw with the counter-based generator? */
+  uint32_t randSeed; /* Seed for the counter-based generator */
+  uint64_t threshold; /* CounterThreshold() of the burn probability */
+  int curStep; /* The current time step */
+  int64_t nBurnedTrees; /* Trees that have caught fire so far */
+};
+
+/* Define the phases of the simulation that are timed */
+enum Phase {
+  PHASE_INIT, /* Allocating and initializing the forest */
+  PHASE_CONTINUE_BURNING, /* ContinueBurning() */
+  PHASE_BURN_NEW, /* BurnNew() */
+  PHASE_ADVANCE_TIME, /* AdvanceTime() */
+  PHASE_STEP, /* The single step of every other engine */
+  PHASE_OUTPUT, /* Writing tree data */
+  PHASE_CHECKPOINT, /* Starting a checkpoint */
+  N_PHASES
+};
+
+/* Return whether a tree with the given state is on fire
+
+   @param state The number of time steps the tree has burned
+   @param nMaxBurnSteps A tree stops burning after this many time steps
+   @return Whether the tree is on fire
+   */
+static inline bool IsStateOnFire(const int state, const int nMaxBurnSteps) {
+  return state > 0 && state < nMaxBurnSteps;
+}
+
+/* Grow a bounding box to include a tree
+
+   @param stats The statistics holding the bounding box
+   @param row The row index of the tree
+   @param col The column index of the tree
+   */
+static inline void AddToBoundingBox(struct ForestStats *stats, const int row,
+    const int col) {
+  stats->minRow = row < stats->minRow ? row : stats->minRow;
+  stats->maxRow = row > stats->maxRow ? row : stats->maxRow;
+  stats->minCol = col < stats->minCol ? col : stats->minCol;
+  stats->maxCol = col > stats->maxCol ? col : stats->maxCol;
+}
+
+/* Allocate and free forests, on huge pages if possible (fire-memory.c) */
+void *AllocateForest(const size_t size);
+void FreeForest(void *forest, const size_t size);
+
+/* Return whether a tree next to a burning tree catches fire
+   (fire-serial.c) */
+bool CatchesFire(const int row, const int col);
+bool CatchesFireWithChance(const int row, const int col, const int percent);
+
+/* Return the state of a tree, wherever the selected engine stores it
+   (fire-serial.c) */
+int GetTreeState(const int row, const int col);
+
+/* Advance every tree by one time step using all available threads, adding
+   up the statistics of the forest if stats is not NULL (fire-parallel.c) */
+void StepParallel(struct ForestStats *stats);
+
+/* Advance only the burning trees and their neighbors by one time step
+   (fire-frontier.c) */
+void InitFrontier();
+bool IsFrontierBurning();
+void StepFrontier();
+void FreeFrontier();
+
+/* Advance every tree by one time step in a single sweep over two identically
+   padded forests (fire-fused.c) */
+void InitFused();
+void StepForestRun(struct ForestRun *run, struct ForestStats *stats);
+void StepFused(struct ForestStats *stats);
+
+/* Catch trees on fire from a wider neighborhood than the 4 nearest trees
+   (fire-stencil.c) */
+int SelectStencil(const char *name);
+void BurnNewStencil();
+void StepFusedStencil();
+
+/* Give each tree its own burn probability, burn steps and wind from a
+   mapped map file (fire-map.c) */
+void MapRaster(const char *filename);
+void ContinueBurningMap();
+void BurnNewMap();
+void StepFusedMap();
+void CloseRaster();
+
+/* Advance every tree by one time step, 8 or 16 trees at a time with AVX2 or
+   AVX-512 when the CPU has them (fire-simd.c) */
+void InitSimd();
+void StepSimd();
+
+/* Advance cache-sized tiles of the forest several time steps at a time,
+   filling one entry of stats and nNewBurning per time step if they are not
+   NULL (fire-tiled.c) */
+int StepTiled(const int maxSteps, struct ForestStats *stats,
+    int64_t *nNewBurning);
+
+/* Compute each tree from its distance to the first tree when every tree next
+   to a burning tree catches fire (fire-wavefront.c) */
+void InitWavefront(const int firstRow, const int firstCol);
+int WavefrontTreeState(const int row, const int col);
+int StepWavefront(const int nSteps, struct ForestStats *stats,
+    int64_t *nNewBurning);
+
+/* Store each tree in one byte or in bit planes rather than an int
+   (fire-compact.c) */
+void AllocateCompact(const bool isBitSliced);
+void InitCompact(const int firstRow, const int firstCol);
+int CompactTreeState(const int row, const int col);
+void StepCompact();
+void FreeCompact();
+
+/* Write tree data as binary frames from a background thread
+   (fire-output.c) */
+void OpenBinaryOutput(FILE *file);
+void QueueBinaryFrame();
+void CloseBinaryOutput();
+
+/* Run many simulations with different burn probabilities and seeds at once
+   (fire-ensemble.c) */
+void RunEnsemble(const int lowProb, const int highProb, const int probStep,
+    const int firstSeed, const int nSeeds, const bool isRandFirstTree);
+
+/* Write the whole simulation to a file in the background, and restart from
+   such a file (fire-checkpoint.c) */
+void WriteCheckpoint(const char *filename, const int engine,
+    const int64_t nNewTrees);
+void WaitForCheckpoint();
+void MapCheckpoint(const char *filename, const int nEngines, int *engine,
+    int64_t *nNewTrees);
+void CloseCheckpoint();
+
+/* Time each phase and read hardware counters for it, writing a JSON or CSV
+   report (fire-profile.c) */
+void StartProfile(const char *filename, const char *engineName);
+void BeginPhase(const enum Phase phase);
+void EndPhase(const enum Phase phase);
+void EndProfileStep(const int step);
+void FinishProfile();
+
+/* Write statistics of the forest at each time step (fire-stats.c) */
+void OpenStats(const char *filename);
+void ClearStats(struct ForestStats *stats);
+void ResetStats();
+void MergeStats(struct ForestStats *stats, const struct ForestStats *part);
+void SweepStats();
+void WriteStats(const int step, const int64_t nBurnedTrees,
+    const int64_t nNewBurning);
+void WriteStepStats(const int firstStep, const int nSteps,
+    int64_t nBurnedTrees);
+void CloseStats();
+
+/* Split the rows of the forest among MPI ranks; only in fire-mpi builds
+   (fire-mpi.c) */
+void InitMpi(const int firstRow, const int firstCol);
+void StepMpi();
+void ReduceMpi();
+void FreeMpi();
+
+#endif
@@ -0,0 +1,232 @@
+/* SIMD engine for the forest fire model.
+
+   BurnNew() decides tree by tree with branches and one random() call per
+   candidate, which compilers cannot vectorize. This engine updates 16
+   (AVX-512) or 8 (AVX2) trees of a row at once without branches: it builds
+   masks of the trees that are on fire, unburned, and next to a burning tree,
+   draws a counter-based random number for every lane with the same hash as
+   fire-rng.h, and blends the next states together.
+
+   The instruction set is chosen at run time from what the CPU supports, and
+   can be forced with the environment variable FIRE_SIMD=avx512, avx2 or
+   scalar. Every version gives the same result as fire-serial -k.
+   */
+
+#include <stdlib.h> /* getenv() */
+#include <string.h> /* strcmp() */
+#include "fire-serial.h"
+#include "fire-kernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD
+#include <immintrin.h> /* AVX2 and AVX-512 intrinsics */
+#endif
+
+/* Update columns 1..nCols of one row and return the number of trees that
+   caught fire */
+typedef int (*StepRowFunction)(const int *above, const int *cur,
+    const int *below, int *next, const int nCols, const int nMaxBurnSteps,
+    const uint32_t rowKey, const uint64_t threshold);
+
+static StepRowFunction StepRow; /* The version chosen by InitSimd() */
+static const char *SimdName; /* Name of the chosen instruction set */
+
+/* Update one row without SIMD, with the kernel of the fused engine; the
+   row index only matters to random() and statistics, neither used here */
+static int StepRowScalar(const int *above, const int *cur, const int *below,
+    int *next, const int nCols, const int nMaxBurnSteps,
+    const uint32_t rowKey, const uint64_t threshold) {
+  return StepRowFour(above, cur, below, next, 1, nCols, nMaxBurnSteps, true,
+      rowKey, threshold, 0, 0, NULL);
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* MixBits() of 8 lanes at once */
+__attribute__((target("avx2")))
+static inline __m256i MixBitsAvx2(__m256i x) {
+  x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+  x = _mm256_mullo_epi32(x, _mm256_set1_epi32(0x7feb352d));
+  x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+  x = _mm256_mullo_epi32(x, _mm256_set1_epi32(0x846ca68b));
+  return _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+}
+
+/* IsStateOnFire() of 8 lanes at once, as all-ones or all-zeros lanes */
+__attribute__((target("avx2")))
+static inline __m256i OnFireAvx2(const __m256i state, const __m256i max) {
+  return _mm256_and_si256(_mm256_cmpgt_epi32(state, _mm256_setzero_si256()),
+      _mm256_cmpgt_epi32(max, state));
+}
+
+/* Update one row 8 trees at a time with AVX2 */
+__attribute__((target("avx2")))
+static int StepRowAvx2(const int *above, const int *cur, const int *below,
+    int *next, const int nCols, const int nMaxBurnSteps,
+    const uint32_t rowKey, const uint64_t threshold) {
+  const __m256i max = _mm256_set1_epi32(nMaxBurnSteps);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i signBit = _mm256_set1_epi32((int)0x80000000U);
+  /* Unsigned rand < threshold, done as a signed compare on flipped sign
+     bits; a threshold of 2^32 or more always passes */
+  const bool isAlwaysCaught = threshold > 0xffffffffU;
+  const __m256i biasedThreshold = _mm256_set1_epi32(
+      (int)((uint32_t)threshold ^ 0x80000000U));
+  const __m256i key = _mm256_set1_epi32((int)rowKey);
+  const __m256i golden = _mm256_set1_epi32((int)COUNTER_RAND_GOLDEN);
+  const __m256i laneCols = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  int nIgnited = 0;
+  int col;
+
+  for (col = 1; col + 8 <= nCols + 1; col += 8) {
+    const __m256i state = _mm256_loadu_si256((const __m256i*)&cur[col]);
+    const __m256i nearFire = _mm256_or_si256(
+        _mm256_or_si256(
+          OnFireAvx2(_mm256_loadu_si256((const __m256i*)&above[col]), max),
+          OnFireAvx2(_mm256_loadu_si256((const __m256i*)&cur[col - 1]), max)),
+        _mm256_or_si256(
+          OnFireAvx2(_mm256_loadu_si256((const __m256i*)&below[col]), max),
+          OnFireAvx2(_mm256_loadu_si256((const __m256i*)&cur[col + 1]), max)));
+    const __m256i candidates = _mm256_and_si256(nearFire,
+        _mm256_cmpeq_epi32(state, _mm256_setzero_si256()));
+    const __m256i cols = _mm256_add_epi32(_mm256_set1_epi32(col), laneCols);
+    const __m256i rand = MixBitsAvx2(_mm256_add_epi32(key,
+          _mm256_mullo_epi32(cols, golden)));
+    const __m256i caught = isAlwaysCaught ?
+      _mm256_set1_epi32(-1) :
+      _mm256_cmpgt_epi32(biasedThreshold, _mm256_xor_si256(rand, signBit));
+    const __m256i ignite = _mm256_and_si256(candidates, caught);
+    __m256i nextState;
+
+    /* Burning trees go up by 1, ignited trees become 1, others stay */
+    nextState = _mm256_add_epi32(state,
+        _mm256_and_si256(OnFireAvx2(state, max), one));
+    nextState = _mm256_blendv_epi8(nextState, one, ignite);
+    _mm256_storeu_si256((__m256i*)&next[col], nextState);
+
+    nIgnited += __builtin_popcount(
+        _mm256_movemask_ps(_mm256_castsi256_ps(ignite)));
+  }
+
+  /* The columns left after the last full vector */
+  nIgnited += StepRowFour(above, cur, below, next, col, nCols, nMaxBurnSteps,
+      true, rowKey, threshold, 0, 0, NULL);
+  return nIgnited;
+}
+
+/* MixBits() of 16 lanes at once */
+__attribute__((target("avx512f")))
+static inline __m512i MixBitsAvx512(__m512i x) {
+  x = _mm512_xor_si512(x, _mm512_srli_epi32(x, 16));
+  x = _mm512_mullo_epi32(x, _mm512_set1_epi32(0x7feb352d));
+  x = _mm512_xor_si512(x, _mm512_srli_epi32(x, 15));
+  x = _mm512_mullo_epi32(x, _mm512_set1_epi32(0x846ca68b));
+  return _mm512_xor_si512(x, _mm512_srli_epi32(x, 16));
+}
+
+/* IsStateOnFire() of 16 lanes at once, as a lane mask */
+__attribute__((target("avx512f")))
+static inline __mmask16 OnFireAvx512(const __m512i state, const __m512i max) {
+  return _mm512_cmpgt_epi32_mask(state, _mm512_setzero_si512()) &
+    _mm512_cmplt_epi32_mask(state, max);
+}
+
+/* Update one row 16 trees at a time with AVX-512 */
+__attribute__((target("avx512f")))
+static int StepRowAvx512(const int *above, const int *cur, const int *below,
+    int *next, const int nCols, const int nMaxBurnSteps,
+    const uint32_t rowKey, const uint64_t threshold) {
+  const __m512i max = _mm512_set1_epi32(nMaxBurnSteps);
+  const __m512i one = _mm512_set1_epi32(1);
+  const bool isAlwaysCaught = threshold > 0xffffffffU;
+  const __m512i threshold32 = _mm512_set1_epi32((int)(uint32_t)threshold);
+  const __m512i key = _mm512_set1_epi32((int)rowKey);
+  const __m512i golden = _mm512_set1_epi32((int)COUNTER_RAND_GOLDEN);
+  const __m512i laneCols = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+      10, 11, 12, 13, 14, 15);
+  int nIgnited = 0;
+  int col;
+
+  for (col = 1; col + 16 <= nCols + 1; col += 16) {
+    const __m512i state = _mm512_loadu_si512(&cur[col]);
+    const __mmask16 onFire = OnFireAvx512(state, max);
+    const __mmask16 nearFire =
+      OnFireAvx512(_mm512_loadu_si512(&above[col]), max) |
+      OnFireAvx512(_mm512_loadu_si512(&cur[col - 1]), max) |
+      OnFireAvx512(_mm512_loadu_si512(&below[col]), max) |
+      OnFireAvx512(_mm512_loadu_si512(&cur[col + 1]), max);
+    const __mmask16 candidates = nearFire &
+      _mm512_cmpeq_epi32_mask(state, _mm512_setzero_si512());
+    const __m512i cols = _mm512_add_epi32(_mm512_set1_epi32(col), laneCols);
+    const __m512i rand = MixBitsAvx512(_mm512_add_epi32(key,
+          _mm512_mullo_epi32(cols, golden)));
+    const __mmask16 caught = isAlwaysCaught ? (__mmask16)0xffff :
+      _mm512_cmplt_epu32_mask(rand, threshold32);
+    const __mmask16 ignite = candidates & caught;
+    __m512i nextState;
+
+    /* Burning trees go up by 1, ignited trees become 1, others stay */
+    nextState = _mm512_mask_add_epi32(state, onFire, state, one);
+    nextState = _mm512_mask_mov_epi32(nextState, ignite, one);
+    _mm512_storeu_si512(&next[col], nextState);
+
+    nIgnited += __builtin_popcount(ignite);
+  }
+
+  /* The columns left after the last full vector */
+  nIgnited += StepRowFour(above, cur, below, next, col, nCols, nMaxBurnSteps,
+      true, rowKey, threshold, 0, 0, NULL);
+  return nIgnited;
+}
+
+#endif /* HAVE_X86_SIMD */
+
+/* Choose the widest instruction set the CPU supports, unless FIRE_SIMD
+   forces one */
+void InitSimd() {
+  const char *forced = getenv("FIRE_SIMD");
+
+  StepRow = StepRowScalar;
+  SimdName = "scalar";
+
+#ifdef HAVE_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") &&
+      (forced == NULL || strcmp(forced, "avx512") == 0)) {
+    StepRow = StepRowAvx512;
+    SimdName = "avx512";
+  }
+  else if (__builtin_cpu_supports("avx2") &&
+      (forced == NULL || strcmp(forced, "avx512") == 0 ||
+       strcmp(forced, "avx2") == 0)) {
+    StepRow = StepRowAvx2;
+    SimdName = "avx2";
+  }
+#endif
+
+  if (forced != NULL && strcmp(forced, SimdName) != 0) {
+    fprintf(stderr, "WARNING: FIRE_SIMD=%s is not available; using %s\n",
+        forced, SimdName);
+  }
+}
+
+/* Advance every tree by one time step with the chosen instruction set, then
+   swap Trees and NewTrees */
+void StepSimd() {
+  const int nColsPlusBounds = NColsPlusBounds;
+  const uint64_t threshold = CounterThreshold(BurnProb);
+  int *swap;
+  int row;
+
+  for (row = 1; row < NRows + 1; row++) {
+    NBurnedTrees += StepRow(&Trees[TREE_MAP(row - 1, 0, nColsPlusBounds)],
+        &Trees[TREE_MAP(row, 0, nColsPlusBounds)],
+        &Trees[TREE_MAP(row + 1, 0, nColsPlusBounds)],
+        &NewTrees[TREE_MAP(row, 0, nColsPlusBounds)], NCols, NMaxBurnSteps,
+        CounterRowKey(RandSeed, CurStep, row), threshold);
+  }
+
+  swap = Trees;
+  Trees = NewTrees;
+  NewTrees = swap;
+}
@@ -0,0 +1,155 @@
+/* Per-time-step statistics for the forest fire model.
+
+   Instead of writing every tree at every time step and measuring the fire
+   afterwards, a few numbers describing the fire at each time step are
+   written as one CSV row:
+
+   step        - the time step, matching "Time step" in the -o output
+   burning     - trees on fire
+   burnt_out   - trees that have stopped burning
+   burned      - trees caught on fire so far
+   perimeter   - edges between a burning tree and an unburned tree, the
+                 length of the fire front
+   min_row ... - the bounding box of the trees that are burning or burnt out
+   new_burning - trees caught on fire on the way to the next time step, the
+                 spread rate
+
+   The serial, fused, parallel and tiled engines add up the statistics in
+   the loops that advance the forest, which already visit every tree and
+   its neighbors; the threaded ones give each thread its own totals and
+   merge them with MergeStats() at the end. The wavefront engine works them
+   out from the distance to the first tree. The tiled and wavefront engines
+   do several time steps at once, so they fill StepStats[] and
+   StepNewBurning[] with one entry per time step. Every other engine calls
+   SweepStats(), one extra read of the forest, before each time step.
+   */
+
+#include <limits.h> /* INT_MAX */
+#include <stdlib.h> /* exit() */
+#include "fire-serial.h"
+
+struct ForestStats CurStats;
+struct ForestStats StepStats[MAX_STATS_STEPS];
+int64_t StepNewBurning[MAX_STATS_STEPS];
+static FILE *StatsFile;
+
+/* Open the statistics file and write its header
+
+   @param filename The statistics file
+   */
+void OpenStats(const char *filename) {
+  StatsFile = fopen(filename, "w");
+  if (StatsFile == NULL) {
+    fprintf(stderr, "ERROR: could not open statistics file '%s'\n",
+        filename);
+    exit(EXIT_FAILURE);
+  }
+  fprintf(StatsFile, "step,burning,burnt_out,burned,perimeter,min_row,"
+      "max_row,min_col,max_col,new_burning\n");
+}
+
+/* Set every statistic to that of a forest with no fire
+
+   @param stats The statistics
+   */
+void ClearStats(struct ForestStats *stats) {
+  stats->nBurning = 0;
+  stats->nBurntOut = 0;
+  stats->perimeter = 0;
+  stats->minRow = INT_MAX;
+  stats->maxRow = 0;
+  stats->minCol = INT_MAX;
+  stats->maxCol = 0;
+}
+
+/* Set CurStats to that of a forest with no fire */
+void ResetStats() {
+  ClearStats(&CurStats);
+}
+
+/* Add the statistics of one part of the forest to those of another
+
+   @param stats The statistics to add to
+   @param part The statistics of the other part
+   */
+void MergeStats(struct ForestStats *stats, const struct ForestStats *part) {
+  stats->nBurning += part->nBurning;
+  stats->nBurntOut += part->nBurntOut;
+  stats->perimeter += part->perimeter;
+  if (part->maxRow > 0) {
+    AddToBoundingBox(stats, part->minRow, part->minCol);
+    AddToBoundingBox(stats, part->maxRow, part->maxCol);
+  }
+}
+
+/* Compute CurStats from the current forest, wherever the selected engine
+   stores it */
+void SweepStats() {
+  int row;
+  int col;
+
+  ResetStats();
+  for (row = 1; row < NRows + 1; row++) {
+    for (col = 1; col < NCols + 1; col++) {
+      const int state = GetTreeState(row, col);
+
+      if (IsStateOnFire(state, NMaxBurnSteps)) {
+        CurStats.nBurning++;
+        AddToBoundingBox(&CurStats, row, col);
+      }
+      else if (state >= NMaxBurnSteps) {
+        CurStats.nBurntOut++;
+        AddToBoundingBox(&CurStats, row, col);
+      }
+      else {
+        /* Count the edges to burning neighbors; the boundary never burns */
+        CurStats.perimeter +=
+          (row > 1     && IsStateOnFire(GetTreeState(row - 1, col),
+                                        NMaxBurnSteps)) +
+          (col > 1     && IsStateOnFire(GetTreeState(row, col - 1),
+                                        NMaxBurnSteps)) +
+          (row < NRows && IsStateOnFire(GetTreeState(row + 1, col),
+                                        NMaxBurnSteps)) +
+          (col < NCols && IsStateOnFire(GetTreeState(row, col + 1),
+                                        NMaxBurnSteps));
+      }
+    }
+  }
+}
+
+/* Write CurStats as the row of a time step
+
+   @param step The time step CurStats describes
+   @param nBurnedTrees The number of trees caught on fire by that step
+   @param nNewBurning The number of trees caught on fire after that step
+   */
+void WriteStats(const int step, const int64_t nBurnedTrees,
+    const int64_t nNewBurning) {
+  fprintf(StatsFile, "%d,%lld,%lld,%lld,%lld,%d,%d,%d,%d,%lld\n", step,
+      (long long)CurStats.nBurning, (long long)CurStats.nBurntOut,
+      (long long)nBurnedTrees, (long long)CurStats.perimeter,
+      CurStats.minRow, CurStats.maxRow, CurStats.minCol, CurStats.maxCol,
+      (long long)nNewBurning);
+}
+
+/* Write StepStats[] as the rows of several time steps done at once
+
+   @param firstStep The time step StepStats[0] describes
+   @param nSteps The number of time steps to write
+   @param nBurnedTrees The number of trees caught on fire by firstStep
+   */
+void WriteStepStats(const int firstStep, const int nSteps,
+    int64_t nBurnedTrees) {
+  int step;
+
+  for (step = 0; step < nSteps; step++) {
+    CurStats = StepStats[step];
+    WriteStats(firstStep + step, nBurnedTrees, StepNewBurning[step]);
+    nBurnedTrees += StepNewBurning[step];
+  }
+}
+
+/* Close the statistics file */
+void CloseStats() {
+  fclose(StatsFile);
+}
@@ -0,0 +1,204 @@
+/* Wider neighborhoods for the forest fire model.
+
+   By default a tree can only catch fire from its four nearest neighbors
+   (the von Neumann neighborhood of radius 1). With -n a tree can catch fire
+   from any burning tree within a larger neighborhood instead:
+
+   moore       - the 8 trees around it (radius 1 square)
+   vonneumann2 - the 12 trees at most 2 steps away north, east, south and
+                 west (radius 2 diamond)
+   moore2      - the 24 trees in the 5x5 square around it
+   vonneumann3 - the 24 trees at most 3 steps away (radius 3 diamond)
+   moore3      - the 48 trees in the 7x7 square around it
+
+   The boundary of burnt out trees is as wide as the radius, so a
+   neighborhood never leaves the padded forest (see InitData()).
+
+   Each neighborhood gets its own copy of BurnNew() and of the fused sweep,
+   stamped out by DEFINE_STENCIL_KERNELS() with the radius and shape as
+   constants. The compiler can unroll the neighbor loops of each copy, so the
+   inner loop has neither a loop over a neighbor list nor an indirect call;
+   the copy to run is picked once per time step.
+
+   A tree is a candidate to catch fire when any tree of its neighborhood is
+   on fire, and candidates are visited in row-major order, so with random()
+   the serial and fused engines still give the same result.
+   */
+
+#include <stdlib.h> /* abs() */
+#include <string.h> /* strcmp() */
+#include "fire-serial.h"
+#include "fire-rng.h"
+
+/* Define every neighborhood other than the default: the suffix of its
+   kernels, its name for -n, its radius and whether it is a square (Moore)
+   rather than a diamond (von Neumann) */
+#define FOR_EACH_STENCIL(STENCIL) \
+  STENCIL(Moore1,      "moore",       1, true)  \
+  STENCIL(VonNeumann2, "vonneumann2", 2, false) \
+  STENCIL(Moore2,      "moore2",      2, true)  \
+  STENCIL(VonNeumann3, "vonneumann3", 3, false) \
+  STENCIL(Moore3,      "moore3",      3, true)
+
+/* Return whether any tree in the neighborhood of a tree is on fire; always
+   inlined so that radius and isSquare are constants in each kernel
+
+   @param tree The tree in a padded forest
+   @param nColsPlusBounds The distance between rows of the forest
+   @param nMaxBurnSteps A tree stops burning after this many time steps
+   @param radius The radius of the neighborhood
+   @param isSquare Is the neighborhood a square rather than a diamond?
+   @return Whether a neighbor is on fire
+   */
+static inline __attribute__((always_inline)) bool IsNextToFire(
+    const int *tree, const int nColsPlusBounds, const int nMaxBurnSteps,
+    const int radius, const bool isSquare) {
+  bool isNextToFire = false;
+  int dRow;
+  int dCol;
+
+  for (dRow = -radius; dRow <= radius; dRow++) {
+    for (dCol = -radius; dCol <= radius; dCol++) {
+      if ((dRow != 0 || dCol != 0) &&
+          (isSquare || abs(dRow) + abs(dCol) <= radius)) {
+        isNextToFire |= IsStateOnFire(
+            tree[(int64_t)dRow * nColsPlusBounds + dCol], nMaxBurnSteps);
+      }
+    }
+  }
+  return isNextToFire;
+}
+
+/* Return the number of the four nearest trees of a tree that are on fire,
+   for the fire front in CurStats
+
+   @param tree The tree in a padded forest
+   @param nColsPlusBounds The distance between rows of the forest
+   @param nMaxBurnSteps A tree stops burning after this many time steps
+   @return The number of burning trees
+   */
+static inline int NBurningNearest(const int *tree, const int nColsPlusBounds,
+    const int nMaxBurnSteps) {
+  return IsStateOnFire(tree[-nColsPlusBounds], nMaxBurnSteps) +
+    IsStateOnFire(tree[-1], nMaxBurnSteps) +
+    IsStateOnFire(tree[nColsPlusBounds], nMaxBurnSteps) +
+    IsStateOnFire(tree[1], nMaxBurnSteps);
+}
+
+/* Stamp out BurnNew() and the fused sweep for one neighborhood
+
+   @param NAME The suffix of the kernels
+   @param RADIUS The radius of the neighborhood
+   @param IS_SQUARE Is the neighborhood a square rather than a diamond?
+   */
+#define DEFINE_STENCIL_KERNELS(NAME, RADIUS, IS_SQUARE) \
+static void BurnNew##NAME() { \
+  const int nColsPlusBounds = NColsPlusBounds; \
+  const int nMaxBurnSteps = NMaxBurnSteps; \
+  int row; \
+  int col; \
+\
+  for (row = 1; row < NRows + 1; row++) { \
+    for (col = 1; col < NCols + 1; col++) { \
+      const int *tree = &Trees[TREE_MAP(row, col, nColsPlusBounds)]; \
+\
+      if (*tree == 0) { \
+        CurStats.perimeter += NBurningNearest(tree, nColsPlusBounds, \
+            nMaxBurnSteps); \
+        if (IsNextToFire(tree, nColsPlusBounds, nMaxBurnSteps, RADIUS, \
+              IS_SQUARE) && CatchesFire(row, col)) { \
+          NewTrees[NEW_TREE_MAP(row, col, NCols)] = 1; \
+          NBurnedTrees++; \
+        } \
+      } \
+    } \
+  } \
+} \
+\
+static void StepFused##NAME() { \
+  const int nColsPlusBounds = NColsPlusBounds; \
+  const int nMaxBurnSteps = NMaxBurnSteps; \
+  const bool isCounterRand = IsCounterRand; \
+  const uint64_t threshold = CounterThreshold(BurnProb); \
+  int *swap; \
+  int row; \
+  int col; \
+\
+  for (row = 1; row < NRows + 1; row++) { \
+    const int *cur = &Trees[TREE_MAP(row, 0, nColsPlusBounds)]; \
+    int *next      = &NewTrees[TREE_MAP(row, 0, nColsPlusBounds)]; \
+    const uint32_t rowKey = CounterRowKey(RandSeed, CurStep, row); \
+\
+    for (col = 1; col < NCols + 1; col++) { \
+      const int state = cur[col]; \
+\
+      if (IsStateOnFire(state, nMaxBurnSteps)) { \
+        next[col] = state + 1; \
+      } \
+      else if (state == 0 && \
+          IsNextToFire(&cur[col], nColsPlusBounds, nMaxBurnSteps, RADIUS, \
+            IS_SQUARE) && \
+          (isCounterRand ? CounterCatchesFire(rowKey, col, threshold) : \
+                           CatchesFire(row, col))) { \
+        next[col] = 1; \
+        NBurnedTrees++; \
+      } \
+      else { \
+        next[col] = state; \
+      } \
+    } \
+  } \
+\
+  swap = Trees; \
+  Trees = NewTrees; \
+  NewTrees = swap; \
+}
+
+#define STENCIL_KERNELS(NAME, STRING, RADIUS, IS_SQUARE) \
+  DEFINE_STENCIL_KERNELS(NAME, RADIUS, IS_SQUARE)
+FOR_EACH_STENCIL(STENCIL_KERNELS)
+
+/* A neighborhood and its kernels */
+struct Stencil {
+  const char *name;
+  int radius;
+  void (*burnNew)();
+  void (*stepFused)();
+};
+
+#define STENCIL_ENTRY(NAME, STRING, RADIUS, IS_SQUARE) \
+  { STRING, RADIUS, BurnNew##NAME, StepFused##NAME },
+static const struct Stencil STENCILS[] = {
+  FOR_EACH_STENCIL(STENCIL_ENTRY)
+};
+#define N_STENCILS ((int)(sizeof(STENCILS) / sizeof(STENCILS[0])))
+
+static const struct Stencil *SelectedStencil = NULL;
+
+/* Choose the neighborhood to burn with
+
+   @param name The name of a neighborhood given to -n
+   @return Its radius, or 0 if there is no neighborhood with that name
+   */
+int SelectStencil(const char *name) {
+  int i;
+
+  for (i = 0; i < N_STENCILS; i++) {
+    if (strcmp(name, STENCILS[i].name) == 0) {
+      SelectedStencil = &STENCILS[i];
+      return SelectedStencil->radius;
+    }
+  }
+  return 0;
+}
+
+/* Do BurnNew() with the chosen neighborhood, adding up the fire front in
+   CurStats */
+void BurnNewStencil() {
+  SelectedStencil->burnNew();
+}
+
+/* Do StepFused() with the chosen neighborhood */
+void StepFusedStencil() {
+  SelectedStencil->stepFused();
+}
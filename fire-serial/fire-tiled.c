@@ -0,0 +1,235 @@
+/* Temporally blocked engine for the forest fire model.
+
+   Once the forest is bigger than the last level cache, every time step of
+   the other engines streams all of Trees and NewTrees through memory. This
+   engine instead cuts the forest into square tiles of TILE_SIZE x TILE_SIZE
+   trees and advances each tile by several time steps (-K) while it is in
+   cache, before moving on to the next tile.
+
+   A tile is copied into a local forest together with a ghost zone as wide
+   as the number of time steps. Each time step the band of the local forest
+   that can still be computed correctly shrinks by one tree on every side,
+   so after the last time step exactly the tile itself is correct and is
+   copied into NewTrees. The ghost zones of neighboring tiles overlap, so
+   some trees are computed more than once, but only the tile that owns a
+   tree counts it as burned. The boundary outside the forest is burnt out,
+   which never changes, so it needs no special case.
+
+   Catching fire uses the counter-based generator in fire-rng.h, which
+   depends only on the seed, time step, row and column, so a tree computed
+   in a ghost zone draws the same number as in its own tile and the result
+   matches fire-serial -k exactly. Tiles are independent, so they are
+   shared among OpenMP threads.
+
+   With -S the same sweep adds up the statistics of each of the time steps,
+   counting only the trees a tile owns, into one set of totals per time
+   step for each thread, which are merged once all tiles are done.
+   */
+
+#include <stdlib.h> /* malloc(), free(), exit() */
+#include <string.h> /* memcpy() */
+#include "fire-serial.h"
+#include "fire-kernel.h"
+
+/* Define the number of rows and columns of trees in a tile; with the default
+   8 time steps, two local forests of a tile plus its ghost zone take about
+   350 KB */
+#define TILE_SIZE 192
+
+/* Advance one tile by several time steps and copy it into NewTrees
+
+   @param firstRow The row index of the tile's first tree in Trees
+   @param firstCol The column index of the tile's first tree in Trees
+   @param nSteps The number of time steps
+   @param local Room for (TILE_SIZE + 2 nSteps)^2 trees
+   @param newLocal The same
+   @param stats Statistics to add the tile to, one per time step, or NULL
+   @param nNewBurning Trees of the tile caught on fire, added up per time
+     step, if stats is not NULL
+   @return The number of the tile's trees caught on fire
+   */
+static int StepTile(const int firstRow, const int firstCol, const int nSteps,
+    int *local, int *newLocal, struct ForestStats *stats,
+    int64_t *nNewBurning) {
+  const int nMaxBurnSteps = NMaxBurnSteps;
+  const uint32_t seed = RandSeed;
+  const uint64_t threshold = CounterThreshold(BurnProb);
+  const int nTileRows = NRows + 1 - firstRow < TILE_SIZE ?
+    NRows + 1 - firstRow : TILE_SIZE;
+  const int nTileCols = NCols + 1 - firstCol < TILE_SIZE ?
+    NCols + 1 - firstCol : TILE_SIZE;
+  const int nLocalRows = nTileRows + 2 * nSteps;
+  const int nLocalCols = nTileCols + 2 * nSteps;
+  /* The tree at local row 0, column 0 is at this row and column of Trees */
+  const int rowOffset = firstRow - nSteps;
+  const int colOffset = firstCol - nSteps;
+  int nBurnedTrees = 0;
+  int *swap;
+  int step;
+  int row;
+  int col;
+
+  /* Copy the tile and its ghost zone; trees past the forest are burnt out
+     like the boundary */
+  for (row = 0; row < nLocalRows; row++) {
+    const int treesRow = rowOffset + row;
+    int *localRow = &local[TREE_MAP(row, 0, nLocalCols)];
+
+    if (treesRow < 1 || treesRow > NRows) {
+      for (col = 0; col < nLocalCols; col++) {
+        localRow[col] = nMaxBurnSteps;
+      }
+    }
+    else {
+      /* Columns firstCopyCol up to lastCopyCol are in the forest */
+      const int firstCopyCol = colOffset < 1 ? 1 - colOffset : 0;
+      const int lastCopyCol = colOffset + nLocalCols - 1 > NCols ?
+        NCols - colOffset : nLocalCols - 1;
+
+      for (col = 0; col < firstCopyCol; col++) {
+        localRow[col] = nMaxBurnSteps;
+      }
+      memcpy(&localRow[firstCopyCol],
+          &Trees[TREE_MAP(treesRow, colOffset + firstCopyCol,
+            NColsPlusBounds)],
+          (lastCopyCol - firstCopyCol + 1) * sizeof(int));
+      for (col = lastCopyCol + 1; col < nLocalCols; col++) {
+        localRow[col] = nMaxBurnSteps;
+      }
+    }
+  }
+
+  for (step = 0; step < nSteps; step++) {
+    /* Only trees at least step + 1 trees in from the edge of the local
+       forest still have correct neighbors */
+    for (row = step + 1; row < nLocalRows - step - 1; row++) {
+      const int *above = &local[TREE_MAP(row - 1, 0, nLocalCols)];
+      const int *cur   = &local[TREE_MAP(row,     0, nLocalCols)];
+      const int *below = &local[TREE_MAP(row + 1, 0, nLocalCols)];
+      int *next        = &newLocal[TREE_MAP(row, 0, nLocalCols)];
+      const uint32_t rowKey = CounterRowKey(seed, CurStep + step,
+          rowOffset + row);
+      const bool isOwnedRow = row >= nSteps && row < nSteps + nTileRows;
+
+      if (isOwnedRow) {
+        int nIgnited;
+
+        /* Only count and measure trees of this tile, not of the ghost zone
+           on either side */
+        StepRowFour(above, cur, below, next, step + 1, nSteps - 1,
+            nMaxBurnSteps, true, rowKey, threshold, rowOffset + row,
+            colOffset, NULL);
+        if (stats != NULL) {
+          nIgnited = StepRowFour(above, cur, below, next, nSteps,
+              nSteps + nTileCols - 1, nMaxBurnSteps, true, rowKey, threshold,
+              rowOffset + row, colOffset, &stats[step]);
+          nNewBurning[step] += nIgnited;
+        }
+        else {
+          nIgnited = StepRowFour(above, cur, below, next, nSteps,
+              nSteps + nTileCols - 1, nMaxBurnSteps, true, rowKey, threshold,
+              rowOffset + row, colOffset, NULL);
+        }
+        nBurnedTrees += nIgnited;
+        StepRowFour(above, cur, below, next, nSteps + nTileCols,
+            nLocalCols - step - 2, nMaxBurnSteps, true, rowKey, threshold,
+            rowOffset + row, colOffset, NULL);
+      }
+      else {
+        StepRowFour(above, cur, below, next, step + 1, nLocalCols - step - 2,
+            nMaxBurnSteps, true, rowKey, threshold, rowOffset + row,
+            colOffset, NULL);
+      }
+    }
+
+    swap = local;
+    local = newLocal;
+    newLocal = swap;
+  }
+
+  /* Copy the tile, now nSteps time steps ahead, into NewTrees */
+  for (row = nSteps; row < nSteps + nTileRows; row++) {
+    memcpy(&NewTrees[TREE_MAP(rowOffset + row, firstCol, NColsPlusBounds)],
+        &local[TREE_MAP(row, nSteps, nLocalCols)], nTileCols * sizeof(int));
+  }
+
+  return nBurnedTrees;
+}
+
+/* Advance every tree by up to NTileSteps time steps, one tile at a time,
+   then swap Trees and NewTrees, which must have the same boundary (see
+   InitFused())
+
+   @param maxSteps The most time steps to advance, at least 1, and at most
+     MAX_STATS_STEPS if stats is not NULL
+   @param stats Set to the statistics of the forest before each time step
+     advanced, or NULL
+   @param nNewBurning Set to the trees caught on fire during each time step
+     advanced, if stats is not NULL
+   @return The number of time steps advanced
+   */
+int StepTiled(const int maxSteps, struct ForestStats *stats,
+    int64_t *nNewBurning) {
+  const int nSteps = maxSteps < NTileSteps ? maxSteps : NTileSteps;
+  const int nTileRows = (NRows + TILE_SIZE - 1) / TILE_SIZE;
+  const int nTileCols = (NCols + TILE_SIZE - 1) / TILE_SIZE;
+  const size_t nLocalTrees = (size_t)(TILE_SIZE + 2 * nSteps) *
+    (TILE_SIZE + 2 * nSteps);
+  int64_t nBurnedTrees = 0;
+  int *swap;
+  int step;
+
+  if (stats != NULL) {
+    for (step = 0; step < nSteps; step++) {
+      ClearStats(&stats[step]);
+      nNewBurning[step] = 0;
+    }
+  }
+
+#pragma omp parallel private(step) reduction(+:nBurnedTrees)
+  {
+    /* Each thread reuses its local forests for all of its tiles, and adds
+       up the statistics of its tiles before merging them */
+    int *local = (int*)malloc(nLocalTrees * sizeof(int));
+    int *newLocal = (int*)malloc(nLocalTrees * sizeof(int));
+    struct ForestStats threadStats[MAX_STATS_STEPS];
+    int64_t threadNewBurning[MAX_STATS_STEPS];
+    int tile;
+
+    if (local == NULL || newLocal == NULL) {
+      fprintf(stderr, "ERROR: out of memory for a tile\n");
+      exit(EXIT_FAILURE);
+    }
+
+    if (stats != NULL) {
+      for (step = 0; step < nSteps; step++) {
+        ClearStats(&threadStats[step]);
+        threadNewBurning[step] = 0;
+      }
+    }
+
+#pragma omp for schedule(dynamic)
+    for (tile = 0; tile < nTileRows * nTileCols; tile++) {
+      nBurnedTrees += StepTile(1 + (tile / nTileCols) * TILE_SIZE,
+          1 + (tile % nTileCols) * TILE_SIZE, nSteps, local, newLocal,
+          stats != NULL ? threadStats : NULL, threadNewBurning);
+    }
+
+    if (stats != NULL) {
+#pragma omp critical
+      for (step = 0; step < nSteps; step++) {
+        MergeStats(&stats[step], &threadStats[step]);
+        nNewBurning[step] += threadNewBurning[step];
+      }
+    }
+
+    free(local);
+    free(newLocal);
+  }
+
+  NBurnedTrees += nBurnedTrees;
+  swap = Trees;
+  Trees = NewTrees;
+  NewTrees = swap;
+  return nSteps;
+}
@@ -0,0 +1,137 @@
+/* Wavefront engine for the forest fire model, for -b 100.
+
+   When every tree next to a burning tree catches fire, nothing is left to
+   chance: the fire spreads one tree north, east, south and west every time
+   step, so a tree catches fire at the time step equal to its Manhattan
+   distance from the first tree, and burns out NMaxBurnSteps - 1 time steps
+   later. The forest is a rectangle with no gaps, so the fire always has a
+   shortest path to every tree.
+
+   This engine stores no forest at all. The state of any tree at the current
+   time step comes straight from its distance, and the number of trees
+   burned by a time step is counted a row at a time, so advancing any number
+   of time steps costs O(NRows) rather than O(NSteps * NTrees). Statistics
+   come from the distances too, at O(NRows) per time step; output still
+   costs O(NTrees) for each time step it looks at.
+   */
+
+#include <stdlib.h> /* abs() */
+#include "fire-serial.h"
+
+static int FirstRow; /* The row index of the first tree lit */
+static int FirstCol; /* The column index of the first tree lit */
+
+/* Remember where the fire starts
+
+   @param firstRow The row index of the first tree to light
+   @param firstCol The column index of the first tree to light
+   */
+void InitWavefront(const int firstRow, const int firstCol) {
+  FirstRow = firstRow;
+  FirstCol = firstCol;
+}
+
+/* Return the state of a tree at the current time step
+
+   @param row The row index of the tree
+   @param col The column index of the tree
+   @return The number of time steps the tree has burned
+   */
+int WavefrontTreeState(const int row, const int col) {
+  const int64_t distance = (int64_t)abs(row - FirstRow) + abs(col - FirstCol);
+
+  if (distance > CurStep) {
+    /* The fire has not reached this tree yet */
+    return 0;
+  }
+  return CurStep - distance + 1 < NMaxBurnSteps ?
+    (int)(CurStep - distance + 1) : NMaxBurnSteps;
+}
+
+/* Return the number of trees at most a given distance from the first tree,
+   which are the trees burned by that time step
+
+   @param maxDistance The distance
+   @return The number of trees
+   */
+static int64_t NTreesWithin(const int64_t maxDistance) {
+  int64_t nTrees = 0;
+  int row;
+
+  for (row = 1; row < NRows + 1; row++) {
+    const int64_t halfWidth = maxDistance - abs(row - FirstRow);
+
+    if (halfWidth >= 0) {
+      /* The trees of this row close enough, clipped to the forest */
+      const int64_t lowCol = FirstCol - halfWidth > 1 ?
+        FirstCol - halfWidth : 1;
+      const int64_t highCol = FirstCol + halfWidth < NCols ?
+        FirstCol + halfWidth : NCols;
+
+      nTrees += highCol - lowCol + 1;
+    }
+  }
+  return nTrees;
+}
+
+/* Compute the statistics of the forest at a time step from the distances
+   of its trees: trees up to step away have caught fire, and those more than
+   step + 1 - NMaxBurnSteps away are still burning. Trees next to each other
+   are one apart, so the only unburned trees next to burning ones are those
+   step + 1 away, each with one burning neighbor per direction, row and
+   column, that leads back towards the first tree.
+
+   @param step The time step
+   @param stats Set to the statistics
+   */
+static void WavefrontStats(const int64_t step, struct ForestStats *stats) {
+  const int64_t nBurned = NTreesWithin(step);
+  const int64_t nBurntOut = NTreesWithin(step + 1 - NMaxBurnSteps);
+  int row;
+
+  ClearStats(stats);
+  stats->nBurning = nBurned - nBurntOut;
+  stats->nBurntOut = nBurntOut;
+  AddToBoundingBox(stats, FirstRow - step > 1 ? FirstRow - step : 1,
+      FirstCol - step > 1 ? FirstCol - step : 1);
+  AddToBoundingBox(stats, FirstRow + step < NRows ? FirstRow + step : NRows,
+      FirstCol + step < NCols ? FirstCol + step : NCols);
+  for (row = 1; row < NRows + 1; row++) {
+    const int64_t halfWidth = step + 1 - abs(row - FirstRow);
+    /* 1 if trees of this row have a burning neighbor above or below */
+    const int nAlongCol = row != FirstRow;
+
+    if (halfWidth == 0) {
+      stats->perimeter += nAlongCol;
+    }
+    else if (halfWidth > 0) {
+      stats->perimeter += (nAlongCol + 1) *
+        ((FirstCol - halfWidth >= 1) + (FirstCol + halfWidth <= NCols));
+    }
+  }
+}
+
+/* Advance every tree by several time steps at once
+
+   @param nSteps The number of time steps, at least 1, and at most
+     MAX_STATS_STEPS if stats is not NULL
+   @param stats Set to the statistics of the forest before each time step
+     advanced, or NULL
+   @param nNewBurning Set to the trees caught on fire during each time step
+     advanced, if stats is not NULL
+   @return The number of time steps advanced
+   */
+int StepWavefront(const int nSteps, struct ForestStats *stats,
+    int64_t *nNewBurning) {
+  int step;
+
+  if (stats != NULL) {
+    for (step = 0; step < nSteps; step++) {
+      WavefrontStats((int64_t)CurStep + step, &stats[step]);
+      nNewBurning[step] = NTreesWithin((int64_t)CurStep + step + 1) -
+        NTreesWithin((int64_t)CurStep + step);
+    }
+  }
+  NBurnedTrees = NTreesWithin((int64_t)CurStep + nSteps);
+  return nSteps;
+}
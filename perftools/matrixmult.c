@@ -1,116 +1,173 @@
+// Compute the matrix product Z = X * Y in different ways, and time them.
+// Run with no arguments to pick a version interactively, or with options
+// to benchmark (see mm_bench.c, or run with -h).
 # include <stdlib.h>
 # include <stdio.h>
+# include <string.h>
 # include <math.h>
-#include <sys/time.h>
+# include <time.h>
+# include "matrixmult.h"
+# ifdef _OPENMP
+# include <omp.h>
+# endif
+
+//Work items each thread should get from mult_tiling_omp(), so that tiles
+//of uneven size still balance
+#define OMP_ITEMS_PER_THREAD 8
+
 // Global variables
+int numRow = NUM_ROW, numCol = NUM_COL;
 double **matX, **matY, **matZ;
-struct timeval start_time, stop_time, elapsed_time;  // timers
+//Contiguous copies of the matrices: one aligned block each, rows ldFlat
+//doubles apart
+double *flatX, *flatY, *flatZ;
+int ldFlat;
+//Tile shape of the tiling versions; mm_tune.c may replace it with a tuned
+//one
+struct TileShape mmTile = { BLOCK_SIZE, BLOCK_SIZE, BLOCK_SIZE, 1 };
+double start_time, elapsed_time;  // timers
 
 // Functions Declaration
-// allocMem wrapper to allocate memory for each matrix
-void allocMem();
-// freeMem wrapper to take back allocated memory
-void freeMem();
-
 //matrix multiply naive version
 double matrix_mult_naive(double** matX, double** matY, double** matZ);
 
 //matrix multiply tiling version
 double matrix_mult_tiling(double** matX, double** matY, double** matZ);
 
+//matrix multiply naive and tiling versions on the contiguous matrices
+double matrix_mult_naive_flat(double* restrict matX, double* restrict matY,
+        double* restrict matZ, int ld);
+double matrix_mult_tiling_flat(double* restrict matX, double* restrict matY,
+        double* restrict matZ, int ld);
+
+//matrix multiply blocked for every cache level, on the contiguous matrices
+double matrix_mult_tiling_levels(double* restrict matX,
+        double* restrict matY, double* restrict matZ, int ld);
+
+//Strassen-Winograd matrix multiply on the contiguous matrices, checked
+//against the classical product
+double matrix_mult_strassen(double* restrict matX, double* restrict matY,
+        double* restrict matZ, int ld);
+
+//check that both layouts computed the same product
+int sameResult();
+
 //print test 
 void printMat();
 
-#define NUM_ROW 1500   //Number of rows in each matrix
-#define NUM_COL 1500   //Number of column in each matrix
-
 int main (int argc, char **argv){
     
+    if (argc > 1){
+        //Benchmark mode: everything comes from the command line
+        return runBenchmark(argc, argv);
+    }
+
     matX=matY=matZ=NULL;
+    flatX=flatY=flatZ=NULL;
 
+    //Tuned block sizes for this CPU and size, if there are any
+    loadTuning(numRow);
     allocMem();
+    allocFlat();
     
     int matType;
+    double ptr_t, flat_t, levels_t;
     //double start_t, end_t, compute_t = 0.0;
     printf ("Compute matrix product Z = X * Y.\n" );
     printf("  How do you want to compute the matrix\n"
-            "  enter [1] for Naive, or [2] for tiling\n");
+            "  enter [1] for Naive, [2] for tiling, or [3] for Strassen\n");
     scanf("%d", &matType);
     switch(matType)
     {
         case 1:
-            matrix_mult_naive(matX, matY, matZ);
+            ptr_t = matrix_mult_naive(matX, matY, matZ);
+            flat_t = matrix_mult_naive_flat(flatX, flatY, flatZ, ldFlat);
             break;
         case 2:
-            matrix_mult_tiling(matX, matY, matZ);
+            ptr_t = matrix_mult_tiling(matX, matY, matZ);
+            flat_t = matrix_mult_tiling_flat(flatX, flatY, flatZ, ldFlat);
             break;
+        case 3:
+            //Contiguous layout only, and it checks itself against the
+            //classical product
+            matrix_mult_strassen(flatX, flatY, flatZ, ldFlat);
+            freeFlat();
+            freeMem();
+            return 0;
         default:
-            printf("Please enter either 'n' or 't' \n");
+            printf("Please enter 1 (naive), 2 (tiling) or 3 (Strassen)\n");
             exit(1);
     }
     printMat();
+    if (!sameResult()){
+        printf("Contiguous and pointer-of-pointers results differ!\n");
+        exit(1);
+    }
+    printf("||==Contiguous layout speedup over pointer-of-pointers: "
+            "%.2fx==||\n", ptr_t / flat_t);
+    if (matType == 2){
+        //Then block for L1, L2 and L3 instead of one tile size
+        levels_t = matrix_mult_tiling_levels(flatX, flatY, flatZ, ldFlat);
+        if (!sameResult()){
+            printf("Multi-level and single-level tiling results differ!\n");
+            exit(1);
+        }
+        printf("||==Multi-level speedup over single-level tiling: "
+                "%.2fx==||\n", flat_t / levels_t);
+    }
     //Call function to free memory allocated for each matrix
+    freeFlat();
     freeMem();
     return 0;
 } //END: main()
 
 //Naieve way of matrix multiply
 double matrix_mult_naive(double** matX, double** matY, double** matZ){
-    int i, j, k;
+    int i, j;
     printf("|---This is naive matrix multiply---|\n");
     //Initialize matA basically each element is the sum of index i+j.
 // Directive inserted by Cray Reveal.  May be incomplete.
 #pragma omp parallel for default(none)                                   \
         private (i,j)                                                    \
-        shared  (matX)
-    for ( i = 0; i < NUM_ROW; i++ ){
-        for ( j = 0; j < NUM_COL; j++ ){
+        shared  (matX,numRow,numCol)
+    for ( i = 0; i < numRow; i++ ){
+        for ( j = 0; j < numCol; j++ ){
             matX[i][j] = 1;
         }
     } //END: outerloop
     //Initialize matB basically to product of indicies for each element.
-    for ( i = 0; i < NUM_ROW; i++ ){
-        for ( j = 0; j < NUM_COL; j++ )
+    for ( i = 0; i < numRow; i++ ){
+        for ( j = 0; j < numCol; j++ )
         {
             matY[i][j] = 2;
         }
     } //END: outerloop
     
     //start timer here
-    gettimeofday(&start_time,NULL);         //start time
+    start_time = wallTime();         //start time
     // Compute matSum = matA * matB.
-    for ( i = 0; i < NUM_ROW; i++ ){
-        for ( j = 0; j < NUM_COL; j++ ){
-            matZ[i][j] = 0.0;
-            for ( k = 0; k < NUM_ROW; k++ ){
-                //Actuall multiplication here.
-                matZ[i][j] = matZ[i][j] + matX[i][k] * matY[k][j];
-            }
-        }
-    } //END: outerloop
+    mult_naive(matX, matY, matZ);
     
     //stop timer and calc time taken
-    gettimeofday(&stop_time,NULL);
-    timersub(&stop_time, &start_time, &elapsed_time);
+    elapsed_time = wallTime() - start_time;
     printf("||==Total time was %f seconds.==||\n", 
-            elapsed_time.tv_sec+elapsed_time.tv_usec/1000000.0);
+            elapsed_time);
 
-    return (0);
+    return elapsed_time;
 } //END: matrix_mult_naive()
 
 //matrix multiply with tiling
 double matrix_mult_tiling(double** matX, double** matY, double** matZ){
-    int row, col, prod;
+    int row, col;
     printf("|--This is matrix Multiply by tiling--|\n");
-    int t_r, t_c, t_prod;
     int total_bytes;
     int element_per_tile, tile_bytes;
     int GB = 1024 * 1024 * 1024;
     int MB = 1024 * 1024;
     int KB = 1024;
-    int block_size = 362;//682;
+    int block_size = mmTile.cols;
     //total_bytes = (row_start + row_end) * (col_start + col_end);
-    total_bytes = NUM_ROW * NUM_COL * sizeof(double);
+    total_bytes = numRow * numCol * sizeof(double);
     //total_bytes = total_bytes * sizeof(double);
 
     tile_bytes = block_size * sizeof(double);
@@ -118,44 +175,223 @@ double matrix_mult_tiling(double** matX, double** matY, double** matZ){
     printf("\ttotal_bytes = %d\n", total_bytes);
     printf("\ttile_bytes = %d \n", tile_bytes);
     
-    gettimeofday(&start_time,NULL);         //start time
+    start_time = wallTime();         //start time
     //Initialize matA basically each element is the sum of index i+j.
-    for ( row = 0; row < NUM_ROW; row++ ){
+    for ( row = 0; row < numRow; row++ ){
 // Directive inserted by Cray Reveal.  May be incomplete.
-        for ( col = 0; col < NUM_COL; col++ ){
+        for ( col = 0; col < numCol; col++ ){
             matX[row][col] = 1;
         }
     } //END: outerloop
     //stop timer
-    gettimeofday(&stop_time,NULL);
-    timersub(&stop_time, &start_time, &elapsed_time);
+    elapsed_time = wallTime() - start_time;
     printf("|--Total time for column major is: %f seconds.--|\n", 
-            elapsed_time.tv_sec+elapsed_time.tv_usec/1000000.0);
+            elapsed_time);
     
-    gettimeofday(&start_time,NULL);
+    start_time = wallTime();
     //Initialize matB basically to product of indicies for each element.
-    for ( row = 0; row < NUM_ROW; row++ ){
-        for ( col = 0; col < NUM_COL; col++ )
+    for ( row = 0; row < numRow; row++ ){
+        for ( col = 0; col < numCol; col++ )
         {
             matY[row][col] = 2;
         }
     } //END: outerloop
     //stop timer
-    gettimeofday(&stop_time,NULL);
-    timersub(&stop_time, &start_time, &elapsed_time);
+    elapsed_time = wallTime() - start_time;
     printf("|--Total time for row major: %f seconds.--|\n", 
-            elapsed_time.tv_sec+elapsed_time.tv_usec/1000000.0);
+            elapsed_time);
     
     // Start timer
-    gettimeofday(&start_time,NULL);         //start time
+    start_time = wallTime();         //start time
     // Compute matSum = matA * matB.
+    mult_tiling(matX, matY, matZ);
+    
+    //stop timer
+    elapsed_time = wallTime() - start_time;
+    printf("||==Total time was %f seconds.==||\n", 
+            elapsed_time);
+    
+    return elapsed_time;
+
+} //END: matrix_mult_tiling()
+
+//Naive matrix multiply on the contiguous matrices
+double matrix_mult_naive_flat(double* restrict matX, double* restrict matY,
+        double* restrict matZ, int ld){
+    int i, j;
+    printf("|---This is naive matrix multiply, contiguous---|\n");
+    //Initialize matA basically each element is the sum of index i+j.
+    for ( i = 0; i < numRow; i++ ){
+        for ( j = 0; j < numCol; j++ ){
+            ELEM(matX, i, j, ld) = 1;
+        }
+    } //END: outerloop
+    //Initialize matB basically to product of indicies for each element.
+    for ( i = 0; i < numRow; i++ ){
+        for ( j = 0; j < numCol; j++ ){
+            ELEM(matY, i, j, ld) = 2;
+        }
+    } //END: outerloop
+
+    //start timer here
+    start_time = wallTime();         //start time
+    // Compute matSum = matA * matB.
+    mult_naive_flat(matX, matY, matZ, ld);
+
+    //stop timer and calc time taken
+    elapsed_time = wallTime() - start_time;
+    printf("||==Total time was %f seconds.==||\n", 
+            elapsed_time);
+
+    return elapsed_time;
+} //END: matrix_mult_naive_flat()
+
+//Matrix multiply with tiling on the contiguous matrices
+double matrix_mult_tiling_flat(double* restrict matX, double* restrict matY,
+        double* restrict matZ, int ld){
+    int row, col;
+    printf("|--This is matrix Multiply by tiling, contiguous--|\n");
+
+    //Initialize matA, matB, and zero the product, untimed
+    for ( row = 0; row < numRow; row++ ){
+        for ( col = 0; col < numCol; col++ ){
+            ELEM(matX, row, col, ld) = 1;
+            ELEM(matY, row, col, ld) = 2;
+            ELEM(matZ, row, col, ld) = 0.0;
+        }
+    } //END: outerloop
+
+    // Start timer
+    start_time = wallTime();         //start time
     //tiling loops
-    for (t_r = 0; t_r< NUM_ROW; t_r = t_r + block_size){
-        for (t_c =0; t_c< NUM_COL; t_c = t_c + block_size){
-            for (t_prod = 0; t_prod<NUM_COL; t_prod = t_prod + block_size){
-                for (row = t_r; row < fmin(NUM_COL, t_r+block_size); row++){
-                    for (col = t_c; col < fmin(NUM_COL, t_c+block_size); col++){
-                        for (prod = t_prod; prod < fmin(NUM_COL, t_prod+block_size); prod++){
+    mult_tiling_flat(matX, matY, matZ, ld);
+
+    //stop timer
+    elapsed_time = wallTime() - start_time;
+    printf("||==Total time was %f seconds.==||\n", 
+            elapsed_time);
+
+    return elapsed_time;
+} //END: matrix_mult_tiling_flat()
+
+//Matrix multiply blocked for L1, L2 and L3 on the contiguous matrices
+double matrix_mult_tiling_levels(double* restrict matX,
+        double* restrict matY, double* restrict matZ, int ld){
+    int row, col, measured;
+    double hitRate[3];
+    printf("|--This is matrix Multiply by multi-level tiling, "
+            "contiguous--|\n");
+    printCaches();
+    chooseLevelBlocking(numRow);
+    printLevelBlocking();
+
+    //Initialize matA, matB, and zero the product, untimed
+    for ( row = 0; row < numRow; row++ ){
+        for ( col = 0; col < numCol; col++ ){
+            ELEM(matX, row, col, ld) = 1;
+            ELEM(matY, row, col, ld) = 2;
+            ELEM(matZ, row, col, ld) = 0.0;
+        }
+    } //END: outerloop
+
+    // Start timer
+    startLevelCounters();
+    start_time = wallTime();         //start time
+    //L3, L2 and L1 blocking loops
+    mult_tiling_levels(matX, matY, matZ, ld);
+
+    //stop timer
+    elapsed_time = wallTime() - start_time;
+    measured = stopLevelCounters(numRow, hitRate);
+    printf("||==Total time was %f seconds.==||\n", 
+            elapsed_time);
+    printLevelHitRates(measured, hitRate);
+
+    return elapsed_time;
+} //END: matrix_mult_tiling_levels()
+
+//Strassen-Winograd matrix multiply on the contiguous matrices
+double matrix_mult_strassen(double* restrict matX, double* restrict matY,
+        double* restrict matZ, int ld){
+    int row, col;
+    double *classical;
+    double classical_t, max_error = 0.0, max_x = 0.0, max_y = 0.0;
+    printf("|--This is Strassen-Winograd matrix multiply, contiguous--|\n");
+    printf("\tcrossover to the classical multiply at %d\n", mmCrossover);
+
+    //Initialize matA and matB with values whose products do not add up
+    //exactly, so the rounding error shows, untimed
+    for ( row = 0; row < numRow; row++ ){
+        for ( col = 0; col < numCol; col++ ){
+            ELEM(matX, row, col, ld) = 1.0 / (1 + (row * 7 + col * 3) % 13);
+            ELEM(matY, row, col, ld) = 1.0 / (1 + (row * 5 + col) % 11);
+            max_x = fmax(max_x, ELEM(matX, row, col, ld));
+            max_y = fmax(max_y, ELEM(matY, row, col, ld));
+        }
+    } //END: outerloop
+
+    // Start timer
+    start_time = wallTime();         //start time
+    mult_strassen(numRow, matX, ld, matY, ld, matZ, ld);
+
+    //stop timer
+    elapsed_time = wallTime() - start_time;
+    printf("||==Total time was %f seconds.==||\n", 
+            elapsed_time);
+
+    //The classical product, with the packed multiply
+    if (posix_memalign((void **)&classical, ALIGN_BYTES,
+                (size_t)numRow * ld * sizeof(double)) != 0){
+        printf("Out of memory for the classical product\n");
+        exit(1);
+    }
+    memset(classical, 0, (size_t)numRow * ld * sizeof(double));
+    start_time = wallTime();
+    mult_packed(numRow, numCol, numRow, matX, ld, matY, ld, classical, ld);
+    classical_t = wallTime() - start_time;
+    for ( row = 0; row < numRow; row++ ){
+        for ( col = 0; col < numCol; col++ ){
+            max_error = fmax(max_error, fabs(ELEM(matZ, row, col, ld) -
+                        ELEM(classical, row, col, ld)));
+        }
+    }
+    free(classical);
+    printf("|--Classical (packed) time: %f seconds.--|\n", classical_t);
+    printf("|--Max error against classical: %.3e, relative to "
+            "n*max|X|*max|Y|: %.3e--|\n", max_error,
+            max_error / (numRow * max_x * max_y));
+    printf("||==Strassen speedup over classical: %.2fx==||\n",
+            classical_t / elapsed_time);
+
+    return elapsed_time;
+} //END: matrix_mult_strassen()
+
+//Naieve way of matrix multiply, compute only
+void mult_naive(double** matX, double** matY, double** matZ){
+    int i, j, k;
+    for ( i = 0; i < numRow; i++ ){
+        for ( j = 0; j < numCol; j++ ){
+            matZ[i][j] = 0.0;
+            for ( k = 0; k < numRow; k++ ){
+                //Actuall multiplication here.
+                matZ[i][j] = matZ[i][j] + matX[i][k] * matY[k][j];
+            }
+        }
+    } //END: outerloop
+} //END: mult_naive()
+
+//matrix multiply with tiling, compute only
+void mult_tiling(double** matX, double** matY, double** matZ){
+    int row, col, prod;
+    int t_r, t_c, t_prod;
+    int row_block = mmTile.rows, col_block = mmTile.cols;
+    int prod_block = mmTile.prods;
+    for (t_r = 0; t_r< numRow; t_r = t_r + row_block){
+        for (t_c =0; t_c< numCol; t_c = t_c + col_block){
+            for (t_prod = 0; t_prod<numCol; t_prod = t_prod + prod_block){
+                for (row = t_r; row < fmin(numCol, t_r+row_block); row++){
+                    for (col = t_c; col < fmin(numCol, t_c+col_block); col++){
+                        for (prod = t_prod; prod < fmin(numCol, t_prod+prod_block); prod++){
                             matZ[row][col] = matZ[row][col] + matX[row][prod] * matY[prod][col];
                         } // end of inner loopp
                     }   // end of fifth loop
@@ -163,37 +399,146 @@ double matrix_mult_tiling(double** matX, double** matY, double** matZ){
             } // end of thread loop
         } // end of second loop
     } //end of first outer loop
-    
-    //stop timer
-    gettimeofday(&stop_time,NULL);
-    timersub(&stop_time, &start_time, &elapsed_time);
-    printf("||==Total time was %f seconds.==||\n", 
-            elapsed_time.tv_sec+elapsed_time.tv_usec/1000000.0);
-    
-    return (0);
+} //END: mult_tiling()
 
-} //END: matrix_mult_tiling()
+//Rows per work item of mult_tiling_omp(): at most a tile, but fewer when
+//the tiles alone would give each thread less than OMP_ITEMS_PER_THREAD
+//items. At n=1500 with 362x362 tiles there are only 25 tiles, 9 of them
+//small, which cannot balance over many threads.
+static int ompRowBand(){
+    int threads = 1;
+    int colTiles = (numCol + mmTile.cols - 1) / mmTile.cols;
+    int bands = (numRow + mmTile.rows - 1) / mmTile.rows;
+    int wanted;
+# ifdef _OPENMP
+    threads = omp_get_max_threads();
+# endif
+    wanted = (OMP_ITEMS_PER_THREAD * threads + colTiles - 1) / colTiles;
+    if (wanted > bands){
+        bands = wanted < numRow ? wanted : numRow;
+    }
+    return (numRow + bands - 1) / bands;
+} //END: ompRowBand()
+
+//Matrix multiply with tiling on the contiguous matrices, in parallel: each
+//column tile of matZ is cut into bands of ompRowBand() rows, and the
+//(band, t_c) items are dealt out to the threads in equal contiguous chunks,
+//so each element of matZ has exactly one writer and no locks are needed.
+//A band still runs through the t_prod tiles of its column tile, so matY's
+//tile is reused across its rows. firstTouchFlat() deals the items out the
+//same way, so the pages of a thread's items sit on its own NUMA node.
+void mult_tiling_omp(const double* restrict matX,
+        const double* restrict matY, double* restrict matZ, int ld){
+    int t_r, t_c;
+    int row_band = ompRowBand(), col_block = mmTile.cols;
+#pragma omp parallel for collapse(2) schedule(static) default(none)     \
+        private (t_r,t_c)                                                \
+        shared  (matX,matY,matZ,ld,numRow,numCol,row_band,col_block)
+    for (t_r = 0; t_r< numRow; t_r = t_r + row_band){
+        for (t_c =0; t_c< numCol; t_c = t_c + col_block){
+            const int row_end = t_r + row_band < numRow ?
+                t_r + row_band : numRow;
+            tile_flat(matX, matY, matZ, ld, t_r, row_end, t_c);
+        }
+    }
+} //END: mult_tiling_omp()
+
+//Seconds since some fixed point, on a clock that never jumps
+double wallTime(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1000000000.0;
+} //END: wallTime()
 
 //Allocate Memory to each matrix
 void allocMem(){
     int i;
-    matX = (double **)malloc(NUM_ROW*sizeof(double *));
-    for (i=0;i<NUM_ROW; i++){
-        matX[i]=(double *)malloc(NUM_COL*sizeof(double));
+    matX = (double **)malloc(numRow*sizeof(double *));
+    for (i=0;i<numRow; i++){
+        matX[i]=(double *)malloc(numCol*sizeof(double));
     }
 
-    matY = (double **)malloc(NUM_ROW*sizeof(double *));
-    for (i=0;i<NUM_ROW; i++){
-        matY[i]=(double *)malloc(NUM_COL*sizeof(double));
+    matY = (double **)malloc(numRow*sizeof(double *));
+    for (i=0;i<numRow; i++){
+        matY[i]=(double *)malloc(numCol*sizeof(double));
     }
-    matZ = (double **)malloc(NUM_ROW*sizeof(double *));
-    for (i=0;i<NUM_ROW; i++){
-        matZ[i]=(double *)malloc(NUM_COL*sizeof(double));
+    matZ = (double **)malloc(numRow*sizeof(double *));
+    for (i=0;i<numRow; i++){
+        //zeroed, since the tiling version adds onto it
+        matZ[i]=(double *)calloc(numCol, sizeof(double));
     }
     //return 0;
 
 } //END: allocMem() 
 
+//Leading dimension for ncol columns: a whole number of cache lines, plus one
+//more line if that would make rows a multiple of CRITICAL_STRIDE bytes
+//apart, since then every row of a column would map to the same cache set
+int leadingDim(int ncol){
+    int ld = (ncol + DOUBLES_PER_LINE - 1) / DOUBLES_PER_LINE * DOUBLES_PER_LINE;
+    if ((ld * sizeof(double)) % CRITICAL_STRIDE == 0){
+        ld = ld + DOUBLES_PER_LINE;
+    }
+    return ld;
+} //END: leadingDim()
+
+//Zero the contiguous matrices, item by item, with the same threads and
+//schedule as mult_tiling_omp(). Linux places a page on the NUMA node of
+//the thread that first writes it, so each thread's items of matZ (and the
+//rows of matX it reads most) end up in its local memory. The last column
+//tile runs on to ld so the padding is zeroed too.
+static void firstTouchFlat(){
+    int t_r, t_c;
+    int row_band = ompRowBand(), col_block = mmTile.cols;
+    int ld = ldFlat;
+#pragma omp parallel for collapse(2) schedule(static) default(none)     \
+        private (t_r,t_c)                                                \
+        shared  (flatX,flatY,flatZ,ld,numRow,numCol,row_band,col_block)
+    for (t_r = 0; t_r< numRow; t_r = t_r + row_band){
+        for (t_c =0; t_c< numCol; t_c = t_c + col_block){
+            const int row_end = t_r + row_band < numRow ?
+                t_r + row_band : numRow;
+            const int col_end = t_c + col_block < numCol ?
+                t_c + col_block : ld;
+            int row;
+            for (row = t_r; row < row_end; row++){
+                const size_t bytes = (col_end - t_c) * sizeof(double);
+                memset(&ELEM(flatX, row, t_c, ld), 0, bytes);
+                memset(&ELEM(flatY, row, t_c, ld), 0, bytes);
+                memset(&ELEM(flatZ, row, t_c, ld), 0, bytes);
+            }
+        }
+    }
+} //END: firstTouchFlat()
+
+//Allocate each contiguous matrix as one aligned block
+void allocFlat(){
+    size_t bytes;
+    ldFlat = leadingDim(numCol);
+    bytes = (size_t)numRow * ldFlat * sizeof(double);
+    if (posix_memalign((void **)&flatX, ALIGN_BYTES, bytes) != 0 ||
+            posix_memalign((void **)&flatY, ALIGN_BYTES, bytes) != 0 ||
+            posix_memalign((void **)&flatZ, ALIGN_BYTES, bytes) != 0){
+        printf("Out of memory for the contiguous matrices\n");
+        exit(1);
+    }
+    //Zero the padding too, so it never holds garbage
+    firstTouchFlat();
+} //END: allocFlat()
+
+//Compare the products of the two layouts
+int sameResult(){
+    int i, j;
+    for (i = 0; i < numRow; i++){
+        for (j = 0; j < numCol; j++){
+            if (matZ[i][j] != ELEM(flatZ, i, j, ldFlat)){
+                return 0;
+            }
+        }
+    }
+    return 1;
+} //END: sameResult()
+
 void printMat(){
     int i, j;
     printf("Computed first 6 rows are:\n");
@@ -209,17 +554,24 @@ void printMat(){
 //Free allocated memory to two dimentional arrays
 void freeMem(){
     int i;
-    for (i=NUM_ROW-1; i>=0; i--){
+    for (i=numRow-1; i>=0; i--){
         free(matX[i]);
     }
     free(matX);
-    for (i=NUM_ROW-1; i>=0; i--){
+    for (i=numRow-1; i>=0; i--){
         free(matY[i]);
     }
     free(matY);
-    for (i=NUM_ROW-1; i>=0; i--){
+    for (i=numRow-1; i>=0; i--){
         free(matZ[i]);
     }
     free(matZ);
     //return 0;
 } //END: freeMem()
+
+//Free the contiguous matrices
+void freeFlat(){
+    free(flatX);
+    free(flatY);
+    free(flatZ);
+} //END: freeFlat()
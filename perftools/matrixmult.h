@@ -0,0 +1,166 @@
+//Shared declarations for matrixmult - see matrixmult.c for the program and
+//mm_bench.c for the benchmark driver
+#ifndef MATRIXMULT_H
+#define MATRIXMULT_H
+
+#include <stddef.h>
+#include <complex.h>
+
+#define NUM_ROW 1500   //Default number of rows in each matrix
+#define NUM_COL 1500   //Default number of column in each matrix
+
+#define ALIGN_BYTES 64          //Contiguous matrices start on a cache line
+#define DOUBLES_PER_LINE (ALIGN_BYTES / sizeof(double))
+#define CRITICAL_STRIDE 4096    //Rows this far apart share a cache set
+#define BLOCK_SIZE 362          //Default tile edge of the tiling versions
+
+//Element (i, j) of a contiguous matrix with leading dimension ld
+#define ELEM(mat, i, j, ld) ((mat)[(size_t)(i) * (ld) + (j)])
+
+// Global variables
+extern int numRow, numCol;      //Size of each matrix
+extern double **matX, **matY, **matZ;
+extern double *flatX, *flatY, *flatZ;
+extern int ldFlat;
+
+//tile shape of the tiling versions: rows and columns of matZ and length of
+//the inner product per tile, and how many columns of matZ the flat
+//versions sum at once (1, 2 or 4)
+struct TileShape {
+    int rows, cols, prods, unroll;
+};
+extern struct TileShape mmTile;
+
+//seconds on a monotonic clock, for timing
+double wallTime();
+
+//allocate and free both layouts, numRow x numCol
+void allocMem();
+void freeMem();
+int leadingDim(int ncol);
+void allocFlat();
+void freeFlat();
+
+//compute matZ = matX * matY, timing and printing nothing; the tiling
+//versions add onto matZ, so it must start at zero
+void mult_naive(double** matX, double** matY, double** matZ);
+void mult_tiling(double** matX, double** matY, double** matZ);
+void mult_naive_flat(const double* restrict matX,
+        const double* restrict matY, double* restrict matZ, int ld);
+void mult_tiling_flat(const double* restrict matX,
+        const double* restrict matY, double* restrict matZ, int ld);
+//the tiles of mult_tiling_flat one at a time: rows t_r up to row_end of
+//the t_c column tile of matZ
+void tile_flat(const double* restrict matX, const double* restrict matY,
+        double* restrict matZ, int ld, int t_r, int row_end, int t_c);
+
+//mult_tiling_flat with the (t_r, t_c) tiles shared among OpenMP threads;
+//allocFlat() first touches each tile on the thread that computes it
+void mult_tiling_omp(const double* restrict matX,
+        const double* restrict matY, double* restrict matZ, int ld);
+
+//block sizes of the packed multiply: rows of matX, depth, and columns of
+//matY per block (mm_packed.c)
+struct Blocking {
+    int mc, kc, nc;
+};
+extern struct Blocking mmBlocking;
+
+//matZ += matX * matY for an m x k matX and a k x n matY, with packed
+//panels and a vectorised micro-kernel (mm_packed.c)
+void mult_packed(int m, int n, int k, const double *matX, int ldx,
+        const double *matY, int ldy, double *matZ, int ldz);
+//the same with the caller's workspace of packedWorkspace() doubles,
+//ALIGN_BYTES aligned, so nothing is allocated
+size_t packedWorkspace();
+void mult_packed_ws(int m, int n, int k, const double *matX, int ldx,
+        const double *matY, int ldy, double *matZ, int ldz, double *work);
+const char *packedKernelName();
+//matZ += alpha * op(matX) * op(matY), op() transposing if transX or
+//transY is nonzero, with the same workspace; behind mm_dgemm() (mm_gemm.h)
+void gemm_packed(int transX, int transY, int m, int n, int k, double alpha,
+        const double *matX, int ldx, const double *matY, int ldy,
+        double *matZ, int ldz, double *work);
+
+//data caches of the CPU, mmCaches[0] being L1; levels it lacks have 0 bytes
+#define MAX_CACHE_LEVELS 4
+struct CacheLevel {
+    int level;
+    long bytes;
+    int ways, lineBytes;
+    int sharedBy;               //CPUs sharing it
+    const char *source;         //Where the size came from
+};
+extern struct CacheLevel mmCaches[MAX_CACHE_LEVELS];
+
+//nested blocks of mult_tiling_levels(): micro-tile of matZ, depth of the
+//X sliver in L1, width of the Y panel in L2, height of the X block in L3
+struct LevelBlocking {
+    int mu, nu, kc, nc, mc;
+};
+extern struct LevelBlocking mmLevels;
+
+//read the caches from sysfs, size the blocks for n x n matrices, and
+//multiply with them; measure their hit rates around a run with hardware
+//counters, or model them where there are none (mm_cache.c)
+void detectCaches();
+void printCaches();
+void chooseLevelBlocking(int n);
+void levelHitRates(int n, double hitRate[3]);
+void printLevelBlocking();
+void startLevelCounters();
+int stopLevelCounters(int n, double hitRate[3]);
+void printLevelHitRates(int measured, const double hitRate[3]);
+void mult_tiling_levels(const double* restrict matX,
+        const double* restrict matY, double* restrict matZ, int ld);
+
+//matZ = matX * matY for n x n matrices by Strassen-Winograd recursion,
+//down to mult_packed() at mmCrossover or below; the _ws version takes a
+//workspace of strassenWorkspace(n) doubles, ALIGN_BYTES aligned
+//(mm_strassen.c)
+#define STRASSEN_CROSSOVER 1024
+extern int mmCrossover;
+size_t strassenWorkspace(int n);
+void mult_strassen(int n, const double *matX, int ldx, const double *matY,
+        int ldy, double *matZ, int ldz);
+void mult_strassen_ws(int n, const double *matX, int ldx,
+        const double *matY, int ldy, double *matZ, int ldz, double *work);
+
+//an element type of the generic kernels, for n x n matrices with rows ld
+//elements apart: naive overwrites matZ and tiling adds onto it, and the
+//double ones are mult_naive_flat and mult_tiling_flat (mm_generic.c); get
+//returns element index of a matrix, so one check serves every type
+struct ElemType {
+    const char *name;
+    size_t size;                //Bytes per element
+    int flopsPerMultAdd;        //2 real, 8 complex
+    double tolerance;           //Largest scaled error accepted
+    void (*fill)(int n, void *x, void *y, void *z, int ld,
+            double (*value)(int which, int i, int j));
+    void (*naive)(int n, const void *x, const void *y, void *z, int ld);
+    void (*tiling)(int n, const void *x, const void *y, void *z, int ld);
+    double complex (*get)(const void *mat, size_t index);
+};
+int numElemTypes();
+const struct ElemType *elemType(int i);
+const struct ElemType *findElemType(const char *name);
+int typedLeadingDim(int ncol, size_t size);
+
+//search block sizes for the current size and save the best to the tuning
+//cache, or load them from it; loadTuning() leaves the defaults and
+//returns 0 if this CPU and size were never tuned (mm_tune.c)
+void tuneBlocking();
+int loadTuning(int size);
+const char *tuningCacheName();
+
+//CPU model from /proc/cpuinfo, or "unknown" (mm_bench.c)
+void cpuModel(char *model, int length);
+
+//fastest of reps runs of mult on the contiguous matrices, refilled before
+//each, after warmup runs that are not counted (mm_bench.c)
+double minFlatTime(void (*mult)(), int warmup, int reps);
+
+//run the benchmark described by the command line (mm_bench.c)
+int runBenchmark(int argc, char **argv);
+
+#endif
@@ -0,0 +1,685 @@
+// Benchmark driver for matrixmult: runs chosen variants at chosen sizes,
+// without any prompts, so it can be scripted and compared across machines
+// and compilers.
+//
+// For each size and variant: WARMUP untimed runs, then REPS timed runs on a
+// monotonic clock. Only the multiply is timed; inputs are filled and the
+// product zeroed before each run. Reported per run set: min, median and
+// standard deviation of the time, and GFLOP/s (2*n^3 flops) at the min and
+// median time.
+//
+// Each result is checked against a reference computed the classical way:
+// for a random vector r, Z*r is compared with X*(Y*r), which costs O(n^2)
+// instead of a second O(n^3) multiply. The error is scaled by |X|*(|Y|*|r|),
+// the size rounding errors can reach, and must stay below VERIFY_TOL.
+//
+// Parallel variants run once per thread count given to -t; "scaling" means
+// 1, 2, 4, ... threads up to every processor of the node. Their strong-
+// scaling efficiency is p0*T(p0) / (p*T(p)) at the min time, against the
+// fewest threads p0 run at that size, so with 1 thread it is T(1)/(p*T(p)).
+//
+// The generic_* variants run once per element type given to -p (float,
+// double, complex_float, complex_double, or all), and a table of their
+// GFLOP/s per type, side by side, ends the run.
+//
+// Block sizes tuned for this CPU and size are loaded from the tuning cache
+// before each size (see mm_tune.c); -T searches them first.
+//
+// Usage: matrixmult.exe [-n SIZES] [-v VARIANTS] [-t THREADS] [-p TYPES]
+//                       [-w WARMUP] [-r REPS] [-o FILE] [-T]
+//   SIZES, VARIANTS, THREADS and TYPES are comma-separated lists; FILE gets the
+//   results as JSON if it ends in .json, else as CSV. The exit status is 1
+//   if any result is wrong.
+# include <stdlib.h>
+# include <stdio.h>
+# include <string.h>
+# include <math.h>
+# include <unistd.h>
+# include "matrixmult.h"
+# ifdef _OPENMP
+# include <omp.h>
+# endif
+
+#define DEFAULT_SIZES "1500"
+#define DEFAULT_VARIANTS "all"
+#define DEFAULT_TYPES "double"
+#define DEFAULT_WARMUP 1
+#define DEFAULT_REPS 5
+#define MAX_SIZES 64
+#define MAX_THREAD_COUNTS 64
+#define MAX_TYPES 16            //Element types given to -p
+#define VERIFY_TOL 1e-10        //Largest scaled error accepted
+
+//Which matrices a variant works on
+enum Layout { LAYOUT_PTR, LAYOUT_FLAT, LAYOUT_TYPED };
+
+//A variant that can be benchmarked
+struct Variant {
+    const char *name;
+    enum Layout layout;
+    int parallel;               //Uses OpenMP threads
+    void (*mult)();             //matZ = matX * matY on the globals
+};
+
+//Results of one variant at one size
+struct Result {
+    int size;
+    const char *variant;
+    const char *type;
+    int threads;
+    int reps;
+    double minTime, medianTime, stddevTime;
+    double minGflops, medianGflops;
+    double efficiency;          //Strong scaling; 1 for serial variants
+    double error;
+    int verified;
+};
+
+// Functions Declaration
+static void runNaive();
+static void runTiling();
+static void runNaiveFlat();
+static void runTilingFlat();
+static void runPacked();
+static void runTilingOmp();
+static void runTilingLevels();
+static void runStrassen();
+static void runGenericNaive();
+static void runGenericTiling();
+
+static const struct Variant VARIANTS[] = {
+    { "naive",       LAYOUT_PTR,  0, runNaive },
+    { "tiling",      LAYOUT_PTR,  0, runTiling },
+    { "naive_flat",  LAYOUT_FLAT, 0, runNaiveFlat },
+    { "tiling_flat", LAYOUT_FLAT, 0, runTilingFlat },
+    { "packed",      LAYOUT_FLAT, 0, runPacked },
+    { "tiling_omp",  LAYOUT_FLAT, 1, runTilingOmp },
+    { "tiling_levels", LAYOUT_FLAT, 0, runTilingLevels },
+    { "strassen",    LAYOUT_FLAT, 0, runStrassen },
+    { "generic_naive",  LAYOUT_TYPED, 0, runGenericNaive },
+    { "generic_tiling", LAYOUT_TYPED, 0, runGenericTiling },
+};
+#define NUM_VARIANTS ((int)(sizeof(VARIANTS) / sizeof(VARIANTS[0])))
+
+static void runNaive(){ mult_naive(matX, matY, matZ); }
+static void runTiling(){ mult_tiling(matX, matY, matZ); }
+static void runNaiveFlat(){ mult_naive_flat(flatX, flatY, flatZ, ldFlat); }
+static void runTilingFlat(){ mult_tiling_flat(flatX, flatY, flatZ, ldFlat); }
+static void runPacked(){
+    mult_packed(numRow, numCol, numRow, flatX, ldFlat, flatY, ldFlat, flatZ,
+            ldFlat);
+}
+static void runTilingOmp(){ mult_tiling_omp(flatX, flatY, flatZ, ldFlat); }
+static void runTilingLevels(){
+    mult_tiling_levels(flatX, flatY, flatZ, ldFlat);
+}
+static void runStrassen(){
+    mult_strassen(numRow, flatX, ldFlat, flatY, ldFlat, flatZ, ldFlat);
+}
+
+//Matrices of the generic variants, of the element type being run
+static const struct ElemType *curType;
+static void *typedX, *typedY, *typedZ;
+static int ldTyped;
+
+static void runGenericNaive(){
+    curType->naive(numRow, typedX, typedY, typedZ, ldTyped);
+}
+static void runGenericTiling(){
+    curType->tiling(numRow, typedX, typedY, typedZ, ldTyped);
+}
+
+//Allocate and free the matrices of the generic variants, numRow x numCol
+//of curType
+static void allocTyped(){
+    size_t bytes;
+    ldTyped = typedLeadingDim(numCol, curType->size);
+    bytes = (size_t)numRow * ldTyped * curType->size;
+    if (posix_memalign(&typedX, ALIGN_BYTES, bytes) != 0 ||
+            posix_memalign(&typedY, ALIGN_BYTES, bytes) != 0 ||
+            posix_memalign(&typedZ, ALIGN_BYTES, bytes) != 0){
+        printf("Out of memory for the %s matrices\n", curType->name);
+        exit(1);
+    }
+    memset(typedX, 0, bytes);
+    memset(typedY, 0, bytes);
+    memset(typedZ, 0, bytes);
+} //END: allocTyped()
+
+static void freeTyped(){
+    free(typedX);
+    free(typedY);
+    free(typedZ);
+} //END: freeTyped()
+
+//Processors of the node, and setting the threads of the next parallel
+//region; without OpenMP there is just one
+static int numProcs(){
+# ifdef _OPENMP
+    return omp_get_num_procs();
+# else
+    return 1;
+# endif
+} //END: numProcs()
+
+static void setThreads(int threads){
+# ifdef _OPENMP
+    omp_set_num_threads(threads);
+# else
+    (void)threads;
+# endif
+} //END: setThreads()
+
+//Print how to run the benchmark, then exit
+static void usage(const char *exeName){
+    int v;
+    fprintf(stderr, "Usage: %s [-n SIZES] [-v VARIANTS] [-t THREADS] "
+            "[-p TYPES] [-w WARMUP] [-r REPS] [-o FILE] [-T]\n", exeName);
+    fprintf(stderr, "  -n  comma-separated matrix sizes (default %s)\n",
+            DEFAULT_SIZES);
+    fprintf(stderr, "  -v  comma-separated variants, or all (default %s):",
+            DEFAULT_VARIANTS);
+    for (v = 0; v < NUM_VARIANTS; v++){
+        fprintf(stderr, " %s", VARIANTS[v].name);
+    }
+    fprintf(stderr, "\n  -t  comma-separated thread counts for parallel "
+            "variants, or scaling\n      for 1, 2, 4, ... up to %d "
+            "(default %d)\n", numProcs(), numProcs());
+    fprintf(stderr, "  -p  comma-separated element types for generic "
+            "variants, or all (default %s):", DEFAULT_TYPES);
+    for (v = 0; v < numElemTypes(); v++){
+        fprintf(stderr, " %s", elemType(v)->name);
+    }
+    fprintf(stderr, "\n  -w  untimed warmup runs (default %d)\n",
+            DEFAULT_WARMUP);
+    fprintf(stderr, "  -r  timed runs (default %d)\n", DEFAULT_REPS);
+    fprintf(stderr, "  -o  write results to FILE, JSON if it ends in .json, "
+            "else CSV\n");
+    fprintf(stderr, "  -T  tune block sizes for each size first, saving them "
+            "to %s\n", tuningCacheName());
+    exit(1);
+} //END: usage()
+
+//Pseudo-random value in [-1, 1) for element (i, j) of input which, the
+//same in every layout and run
+static double inputValue(int which, int i, int j){
+    unsigned int h = (unsigned int)which * 2654435761u;
+    h ^= (unsigned int)i * 2246822519u;
+    h = (h << 13 | h >> 19) ^ (unsigned int)j * 3266489917u;
+    h ^= h >> 15;
+    h *= 2246822519u;
+    h ^= h >> 13;
+    return h / 2147483648.0 - 1.0;
+} //END: inputValue()
+
+//Fill the inputs of a layout and zero its product
+static void fillMatrices(enum Layout layout){
+    int i, j;
+    if (layout == LAYOUT_TYPED){
+        curType->fill(numRow, typedX, typedY, typedZ, ldTyped, inputValue);
+        return;
+    }
+    for (i = 0; i < numRow; i++){
+        for (j = 0; j < numCol; j++){
+            if (layout == LAYOUT_PTR){
+                matX[i][j] = inputValue(0, i, j);
+                matY[i][j] = inputValue(1, i, j);
+                matZ[i][j] = 0.0;
+            } else {
+                ELEM(flatX, i, j, ldFlat) = inputValue(0, i, j);
+                ELEM(flatY, i, j, ldFlat) = inputValue(1, i, j);
+                ELEM(flatZ, i, j, ldFlat) = 0.0;
+            }
+        }
+    }
+} //END: fillMatrices()
+
+//Element (i, j) of matrix X, Y or Z (which 0, 1 or 2) in any layout
+static double complex elemOf(enum Layout layout, int which, int i, int j){
+    double **mat[] = { matX, matY, matZ };
+    const double *flat[] = { flatX, flatY, flatZ };
+    const void *typed[] = { typedX, typedY, typedZ };
+    if (layout == LAYOUT_TYPED){
+        return curType->get(typed[which], (size_t)i * ldTyped + j);
+    }
+    return layout == LAYOUT_PTR ? mat[which][i][j] :
+        ELEM(flat[which], i, j, ldFlat);
+} //END: elemOf()
+
+//Check the product of a layout against X*(Y*r) for a random r
+//
+//@return the largest error, scaled by |X|*(|Y|*|r|)
+static double checkResult(enum Layout layout){
+    double *r, *yrAbs;          //r and |Y|*|r|
+    double complex *yr;         //Y*r
+    double maxError = 0.0;
+    int i, j;
+
+    r = malloc(numCol * sizeof(double));
+    yr = malloc(numRow * sizeof(double complex));
+    yrAbs = malloc(numRow * sizeof(double));
+    for (j = 0; j < numCol; j++){
+        r[j] = inputValue(2, 0, j);
+    }
+    for (i = 0; i < numRow; i++){
+        yr[i] = yrAbs[i] = 0.0;
+        for (j = 0; j < numCol; j++){
+            const double complex y = elemOf(layout, 1, i, j);
+            yr[i] += y * r[j];
+            yrAbs[i] += cabs(y) * fabs(r[j]);
+        }
+    }
+    for (i = 0; i < numRow; i++){
+        double complex zr = 0.0, xyr = 0.0;
+        double bound = 0.0;
+        for (j = 0; j < numCol; j++){
+            zr += elemOf(layout, 2, i, j) * r[j];
+        }
+        for (j = 0; j < numRow; j++){
+            const double complex x = elemOf(layout, 0, i, j);
+            xyr += x * yr[j];
+            bound += cabs(x) * yrAbs[j];
+        }
+        if (cabs(zr - xyr) / bound > maxError){
+            maxError = cabs(zr - xyr) / bound;
+        }
+    }
+    free(r);
+    free(yr);
+    free(yrAbs);
+    return maxError;
+} //END: checkResult()
+
+//Sort helper for the median
+static int compareDoubles(const void *a, const void *b){
+    const double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+} //END: compareDoubles()
+
+//Sort helper for the thread counts
+static int compareInts(const void *a, const void *b){
+    const int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+} //END: compareInts()
+
+//Time warmup + reps runs of a variant, refilling its matrices before each,
+//and set times to the reps runs after the warmup
+static void timeRuns(const struct Variant *variant, int warmup, int reps,
+        double *times){
+    int rep;
+    for (rep = 0; rep < warmup + reps; rep++){
+        double start_t;
+        fillMatrices(variant->layout);
+        start_t = wallTime();
+        variant->mult();
+        if (rep >= warmup){
+            times[rep - warmup] = wallTime() - start_t;
+        }
+    }
+} //END: timeRuns()
+
+//Fastest of reps runs of a multiply on the contiguous matrices, after
+//warmup runs that are not counted
+double minFlatTime(void (*mult)(), int warmup, int reps){
+    const struct Variant variant = { "tune", LAYOUT_FLAT, 0, mult };
+    double *times = malloc(reps * sizeof(double));
+    double minTime;
+    int rep;
+
+    timeRuns(&variant, warmup, reps, times);
+    minTime = times[0];
+    for (rep = 1; rep < reps; rep++){
+        minTime = times[rep] < minTime ? times[rep] : minTime;
+    }
+    free(times);
+    return minTime;
+} //END: minFlatTime()
+
+//Run one variant at the current size
+static struct Result benchmark(const struct Variant *variant, int threads,
+        int warmup, int reps){
+    struct Result result;
+    double *times = malloc(reps * sizeof(double));
+    const int typed = variant->layout == LAYOUT_TYPED;
+    const double flops = (typed ? curType->flopsPerMultAdd : 2.0) *
+        numRow * numCol * numRow;
+    double sum = 0.0, sumSq = 0.0;
+    int rep;
+
+    setThreads(threads);
+    timeRuns(variant, warmup, reps, times);
+
+    result.size = numRow;
+    result.variant = variant->name;
+    result.type = typed ? curType->name : "double";
+    result.threads = threads;
+    result.efficiency = 1.0;
+    result.reps = reps;
+    for (rep = 0; rep < reps; rep++){
+        sum += times[rep];
+        sumSq += times[rep] * times[rep];
+    }
+    qsort(times, reps, sizeof(double), compareDoubles);
+    result.minTime = times[0];
+    result.medianTime = reps % 2 ? times[reps / 2] :
+        (times[reps / 2 - 1] + times[reps / 2]) / 2.0;
+    result.stddevTime = reps > 1 ?
+        sqrt(fmax(0.0, (sumSq - sum * sum / reps) / (reps - 1))) : 0.0;
+    result.minGflops = flops / result.minTime / 1e9;
+    result.medianGflops = flops / result.medianTime / 1e9;
+    result.error = checkResult(variant->layout);
+    result.verified = result.error <=
+        (typed ? curType->tolerance : VERIFY_TOL);
+    free(times);
+    return result;
+} //END: benchmark()
+
+//Find a variant by name
+static const struct Variant *findVariant(const char *name){
+    int v;
+    for (v = 0; v < NUM_VARIANTS; v++){
+        if (strcmp(name, VARIANTS[v].name) == 0){
+            return &VARIANTS[v];
+        }
+    }
+    return NULL;
+} //END: findVariant()
+
+//The CPU model from /proc/cpuinfo, or "unknown"
+void cpuModel(char *model, int length){
+    char line[256];
+    FILE *cpuinfo = fopen("/proc/cpuinfo", "r");
+    snprintf(model, length, "unknown");
+    while (cpuinfo != NULL && fgets(line, sizeof(line), cpuinfo) != NULL){
+        char *colon = strchr(line, ':');
+        if (strncmp(line, "model name", 10) == 0 && colon != NULL){
+            snprintf(model, length, "%s", colon + 2);
+            model[strcspn(model, "\n")] = '\0';
+            break;
+        }
+    }
+    if (cpuinfo != NULL){
+        fclose(cpuinfo);
+    }
+} //END: cpuModel()
+
+//Write the results as JSON or CSV, depending on the filename
+static void writeResults(const char *filename, const struct Result *results,
+        int numResults){
+    const size_t length = strlen(filename);
+    const int isJson = length >= 5 &&
+        strcmp(filename + length - 5, ".json") == 0;
+    char model[128], host[128];
+    FILE *out = fopen(filename, "w");
+    int r;
+
+    if (out == NULL){
+        fprintf(stderr, "Could not open %s\n", filename);
+        exit(1);
+    }
+    cpuModel(model, sizeof(model));
+    if (gethostname(host, sizeof(host)) != 0){
+        snprintf(host, sizeof(host), "unknown");
+    }
+    if (isJson){
+        fprintf(out, "{\n  \"host\": \"%s\",\n  \"cpu\": \"%s\",\n"
+                "  \"compiler\": \"%s\",\n  \"packed_kernel\": \"%s\",\n"
+                "  \"procs\": %d,\n  \"results\": [\n", host, model,
+                __VERSION__, packedKernelName(), numProcs());
+    } else {
+        fprintf(out, "host,cpu,compiler,packed_kernel,procs,size,variant,"
+                "type,threads,reps,min_s,median_s,stddev_s,gflops_min,"
+                "gflops_median,efficiency,error,verified\n");
+    }
+    for (r = 0; r < numResults; r++){
+        const struct Result *res = &results[r];
+        if (isJson){
+            fprintf(out, "    {\"size\": %d, \"variant\": \"%s\", "
+                    "\"type\": \"%s\", \"threads\": %d, \"reps\": %d, "
+                    "\"min_s\": %.6f, "
+                    "\"median_s\": %.6f, \"stddev_s\": %.6f, "
+                    "\"gflops_min\": %.3f, \"gflops_median\": %.3f, "
+                    "\"efficiency\": %.3f, \"error\": %.3e, "
+                    "\"verified\": %s}%s\n", res->size, res->variant,
+                    res->type, res->threads, res->reps, res->minTime, res->medianTime,
+                    res->stddevTime, res->minGflops, res->medianGflops,
+                    res->efficiency, res->error,
+                    res->verified ? "true" : "false",
+                    r + 1 < numResults ? "," : "");
+        } else {
+            fprintf(out, "\"%s\",\"%s\",\"%s\",%s,%d,%d,%s,%s,%d,%d,"
+                    "%.6f,%.6f,%.6f,%.3f,%.3f,%.3f,%.3e,%d\n", host, model,
+                    __VERSION__, packedKernelName(), numProcs(), res->size,
+                    res->variant, res->type, res->threads, res->reps, res->minTime,
+                    res->medianTime, res->stddevTime, res->minGflops,
+                    res->medianGflops, res->efficiency, res->error,
+                    res->verified);
+        }
+    }
+    if (isJson){
+        fprintf(out, "  ]\n}\n");
+    }
+    fclose(out);
+} //END: writeResults()
+
+//Print the GFLOP/s at the min time of each generic variant and size, one
+//column per element type
+static void printGflopsByType(const struct Result *results, int numResults,
+        const struct ElemType **types, int numTypes){
+    int r, q, e;
+    printf("\nGF/s_min by type\n%6s %-15s", "size", "variant");
+    for (e = 0; e < numTypes; e++){
+        printf(" %15s", types[e]->name);
+    }
+    printf("\n");
+    for (r = 0; r < numResults; r++){
+        //One line per size and variant, at its first result
+        if (!findVariant(results[r].variant) ||
+                findVariant(results[r].variant)->layout != LAYOUT_TYPED ||
+                (r > 0 && results[r - 1].size == results[r].size &&
+                 strcmp(results[r - 1].variant, results[r].variant) == 0)){
+            continue;
+        }
+        printf("%6d %-15s", results[r].size, results[r].variant);
+        for (e = 0; e < numTypes; e++){
+            double gflops = 0.0;
+            for (q = r; q < numResults && results[q].size == results[r].size
+                    && strcmp(results[q].variant, results[r].variant) == 0;
+                    q++){
+                if (strcmp(results[q].type, types[e]->name) == 0){
+                    gflops = results[q].minGflops;
+                }
+            }
+            printf(" %15.3f", gflops);
+        }
+        printf("\n");
+    }
+} //END: printGflopsByType()
+
+//Run the benchmark described by the command line
+//
+//@return the exit status: 0, or 1 if any result was wrong
+int runBenchmark(int argc, char **argv){
+    char *sizesArg = DEFAULT_SIZES, *variantsArg = DEFAULT_VARIANTS;
+    char *threadsArg = NULL, *typesArg = DEFAULT_TYPES;
+    char *outFile = NULL;
+    int warmup = DEFAULT_WARMUP, reps = DEFAULT_REPS;
+    int sizes[MAX_SIZES], numSizes = 0;
+    int threadCounts[MAX_THREAD_COUNTS], numThreadCounts = 0;
+    const struct ElemType *types[MAX_TYPES];
+    int numTypes = 0;
+    const struct Variant *chosen[NUM_VARIANTS];
+    int numChosen = 0;
+    struct Result *results;
+    int numResults = 0, allVerified = 1, tune = 0, measured = 0;
+    double hitRate[3];
+    char *token;
+    int c, s, v, t, e;
+
+    while ((c = getopt(argc, argv, "n:v:t:p:w:r:o:Th")) != -1){
+        switch (c){
+            case 'n': sizesArg = optarg; break;
+            case 'v': variantsArg = optarg; break;
+            case 't': threadsArg = optarg; break;
+            case 'p': typesArg = optarg; break;
+            case 'w': warmup = atoi(optarg); break;
+            case 'r': reps = atoi(optarg); break;
+            case 'o': outFile = optarg; break;
+            case 'T': tune = 1; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind < argc || warmup < 0 || reps < 1){
+        usage(argv[0]);
+    }
+
+    //Parse the lists
+    for (token = strtok(sizesArg, ","); token != NULL;
+            token = strtok(NULL, ",")){
+        if (numSizes == MAX_SIZES || atoi(token) < 1){
+            usage(argv[0]);
+        }
+        sizes[numSizes++] = atoi(token);
+    }
+    if (threadsArg == NULL){
+        threadCounts[numThreadCounts++] = numProcs();
+    } else if (strcmp(threadsArg, "scaling") == 0){
+        //Doubling from 1, then the whole node if that is not a power of 2
+        for (t = 1; t < numProcs(); t = t * 2){
+            threadCounts[numThreadCounts++] = t;
+        }
+        threadCounts[numThreadCounts++] = numProcs();
+    } else {
+        for (token = strtok(threadsArg, ","); token != NULL;
+                token = strtok(NULL, ",")){
+            if (numThreadCounts == MAX_THREAD_COUNTS || atoi(token) < 1){
+                usage(argv[0]);
+            }
+            threadCounts[numThreadCounts++] = atoi(token);
+        }
+    }
+# ifndef _OPENMP
+    //Built without OpenMP: parallel variants can only run on one thread
+    threadCounts[0] = 1;
+    numThreadCounts = 1;
+# endif
+    //Fewest threads first, so that run is the base of the efficiency
+    qsort(threadCounts, numThreadCounts, sizeof(int), compareInts);
+    if (strcmp(typesArg, "all") == 0){
+        for (e = 0; e < numElemTypes(); e++){
+            types[numTypes++] = elemType(e);
+        }
+    } else {
+        for (token = strtok(typesArg, ","); token != NULL;
+                token = strtok(NULL, ",")){
+            if (numTypes == MAX_TYPES || findElemType(token) == NULL){
+                fprintf(stderr, "Unknown type %s\n", token);
+                usage(argv[0]);
+            }
+            types[numTypes++] = findElemType(token);
+        }
+    }
+    if (strcmp(variantsArg, "all") == 0){
+        for (v = 0; v < NUM_VARIANTS; v++){
+            chosen[numChosen++] = &VARIANTS[v];
+        }
+    } else {
+        for (token = strtok(variantsArg, ","); token != NULL;
+                token = strtok(NULL, ",")){
+            if (numChosen == NUM_VARIANTS || findVariant(token) == NULL){
+                fprintf(stderr, "Unknown variant %s\n", token);
+                usage(argv[0]);
+            }
+            chosen[numChosen++] = findVariant(token);
+        }
+    }
+    results = malloc(numSizes * numChosen * numThreadCounts * numTypes *
+            sizeof(struct Result));
+
+    printf("packed kernel: %s, %d processors\n", packedKernelName(),
+            numProcs());
+    printCaches();
+    for (s = 0; s < numSizes; s++){
+        int numTuned;
+        numRow = numCol = sizes[s];
+        if (tune){
+            allocFlat();
+            fillMatrices(LAYOUT_FLAT);
+            tuneBlocking();
+            freeFlat();
+        }
+        numTuned = loadTuning(sizes[s]);
+        chooseLevelBlocking(sizes[s]);
+        printf("size %d: tile %d x %d x %d unroll %d, packed %d x %d x %d "
+                "(%s)\n", sizes[s], mmTile.rows, mmTile.cols, mmTile.prods,
+                mmTile.unroll, mmBlocking.mc, mmBlocking.kc, mmBlocking.nc,
+                numTuned > 0 ? "tuned" : "default");
+        printLevelBlocking();
+        printf("%6s %-15s %-15s %7s %10s %10s %10s %10s %10s %6s %9s\n",
+                "size", "variant", "type", "threads", "min_s", "median_s",
+                "stddev_s", "GF/s_min", "GF/s_med", "eff", "error");
+        for (v = 0; v < numChosen; v++){
+            //Serial variants run once; the run of a parallel one on the
+            //fewest threads is the base of its efficiency. Generic ones run
+            //for every type.
+            const int runs = chosen[v]->parallel ? numThreadCounts : 1;
+            const int typed = chosen[v]->layout == LAYOUT_TYPED;
+            for (e = 0; e < (typed ? numTypes : 1); e++){
+                double baseCost = 0.0;
+                curType = types[e];
+                for (t = 0; t < runs; t++){
+                    const int threads =
+                        chosen[v]->parallel ? threadCounts[t] : 1;
+                    struct Result res;
+                    //Allocate with these threads, so pages are first
+                    //touched where they will be used
+                    setThreads(threads);
+                    if (typed){
+                        allocTyped();
+                    } else {
+                        allocMem();
+                        allocFlat();
+                    }
+                    res = benchmark(chosen[v], threads, warmup, reps);
+                    if (chosen[v]->mult == runTilingLevels){
+                        //One more run, untimed, under the cache counters
+                        startLevelCounters();
+                        runTilingLevels();
+                        measured = stopLevelCounters(sizes[s], hitRate);
+                    }
+                    if (typed){
+                        freeTyped();
+                    } else {
+                        freeFlat();
+                        freeMem();
+                    }
+                    if (t == 0){
+                        baseCost = threads * res.minTime;
+                    }
+                    res.efficiency = baseCost / (threads * res.minTime);
+                    printf("%6d %-15s %-15s %7d %10.4f %10.4f %10.4f %10.3f "
+                            "%10.3f %6.2f %9.2e%s\n", res.size, res.variant,
+                            res.type, res.threads, res.minTime,
+                            res.medianTime, res.stddevTime, res.minGflops,
+                            res.medianGflops, res.efficiency, res.error,
+                            res.verified ? "" : "  WRONG");
+                    if (chosen[v]->mult == runTilingLevels){
+                        printLevelHitRates(measured, hitRate);
+                    }
+                    fflush(stdout);
+                    allVerified = allVerified && res.verified;
+                    results[numResults++] = res;
+                }
+            }
+        }
+    }
+    if (numTypes > 1){
+        printGflopsByType(results, numResults, types, numTypes);
+    }
+
+    if (outFile != NULL){
+        writeResults(outFile, results, numResults);
+    }
+    free(results);
+    return allVerified ? 0 : 1;
+} //END: runBenchmark()
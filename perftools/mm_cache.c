@@ -0,0 +1,419 @@
+// Cache topology and multi-level blocking for matrixmult.
+//
+// detectCaches() reads the data caches of the CPU from
+// /sys/devices/system/cpu/cpu0/cache/index*: level, size, ways, line size,
+// and how many CPUs share each one. Levels it cannot read fall back to
+// sysconf(), then to typical sizes.
+//
+// mult_tiling_levels() blocks for every level at once, nested like this:
+//
+//   for each KC-deep slice of the inner dimension      (pc loop)
+//     for each MC-tall block of matX, MC x KC          (ic loop) - in L3
+//       for each NC-wide panel of matY, KC x NC        (jc loop) - in L2
+//         for each MU-tall sliver of matX, MU x KC     (ir loop) - in L1
+//           for each NU-wide sliver of matY            (jr loop)
+//             matZ[MU x NU] += X sliver * Y sliver, in registers
+//
+// so the X block is reused from L3 by every panel of matY, the Y panel from
+// L2 by every sliver of the X block, and the X sliver from L1 by every
+// sliver of the Y panel. chooseLevelBlocking() sizes each block to fill its
+// level but one way, which is left for the data streaming through it; the
+// X block gets only this core's share of L3.
+//
+// The hit rate of each level is measured around a run of
+// mult_tiling_levels() with a group of perf_event_open() counters, as
+// fire-serial's profiler does: L1D loads and their misses, and the loads
+// that reach the last level cache (the L2 misses) and miss it too. Where
+// the kernel gives no counters (see /proc/sys/kernel/perf_event_paranoid,
+// or a virtual machine without a PMU), levelHitRates() models them
+// instead: loads of doubles by the kernel are the L1 accesses, and each
+// level's misses, counted in lines, are the next level's accesses. The
+// printout says which one it is.
+# include <stdlib.h>
+# include <stdio.h>
+# include <string.h>
+# include <stdint.h>
+# include <unistd.h>
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include "matrixmult.h"
+
+#define SYS_CACHE_DIR "/sys/devices/system/cpu/cpu0/cache"
+#define MAX_CACHE_INDEX 16
+#define MU 4                    //Rows of matZ per micro-tile
+#define NU 8                    //Columns of matZ per micro-tile, one line
+
+//Hardware counters of the hit rates, opened as one group
+#define HW_CACHE_EVENT(cache, result) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | ((result) << 16))
+enum { L1_LOADS, L1_MISSES, LLC_LOADS, LLC_MISSES, NUM_LEVEL_COUNTERS };
+static const uint64_t LEVEL_COUNTERS[NUM_LEVEL_COUNTERS] = {
+    HW_CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_ACCESS),
+    HW_CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS),
+    HW_CACHE_EVENT(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_ACCESS),
+    HW_CACHE_EVENT(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_MISS),
+};
+static int counterFds[NUM_LEVEL_COUNTERS];
+static int countersOpen = 0;
+
+struct CacheLevel mmCaches[MAX_CACHE_LEVELS];
+struct LevelBlocking mmLevels = { MU, NU, 256, 256, 256 };
+static int haveCaches = 0;
+
+//Read one line of a file in SYS_CACHE_DIR/index<index>
+//
+//@return 1 if it was read
+static int readCacheFile(int index, const char *file, char *value,
+        int length){
+    char path[256];
+    FILE *in;
+    snprintf(path, sizeof(path), "%s/index%d/%s", SYS_CACHE_DIR, index, file);
+    in = fopen(path, "r");
+    if (in == NULL){
+        return 0;
+    }
+    if (fgets(value, length, in) == NULL){
+        fclose(in);
+        return 0;
+    }
+    fclose(in);
+    value[strcspn(value, "\n")] = '\0';
+    return 1;
+} //END: readCacheFile()
+
+//Number of CPUs in a list like 0-3,8-11
+static int countCpus(const char *list){
+    int count = 0;
+    while (*list != '\0'){
+        char *end;
+        const long first = strtol(list, &end, 10);
+        long last = first;
+        if (end == list){
+            break;
+        }
+        if (*end == '-'){
+            list = end + 1;
+            last = strtol(list, &end, 10);
+        }
+        count += last - first + 1;
+        list = *end == ',' ? end + 1 : end;
+    }
+    return count > 0 ? count : 1;
+} //END: countCpus()
+
+//Fill in the data caches, once
+void detectCaches(){
+    static const int SYSCONF_SIZES[MAX_CACHE_LEVELS] = {
+        _SC_LEVEL1_DCACHE_SIZE, _SC_LEVEL2_CACHE_SIZE,
+        _SC_LEVEL3_CACHE_SIZE, _SC_LEVEL4_CACHE_SIZE };
+    static const int SYSCONF_WAYS[MAX_CACHE_LEVELS] = {
+        _SC_LEVEL1_DCACHE_ASSOC, _SC_LEVEL2_CACHE_ASSOC,
+        _SC_LEVEL3_CACHE_ASSOC, _SC_LEVEL4_CACHE_ASSOC };
+    static const long FALLBACK_BYTES[MAX_CACHE_LEVELS] = {
+        32 * 1024, 1024 * 1024, 8 * 1024 * 1024, 0 };
+    char value[256];
+    int index, l;
+
+    if (haveCaches){
+        return;
+    }
+    memset(mmCaches, 0, sizeof(mmCaches));
+    for (index = 0; index < MAX_CACHE_INDEX; index++){
+        char type[32];
+        struct CacheLevel *cache;
+        long bytes;
+        char unit = 'B';
+        if (!readCacheFile(index, "level", value, sizeof(value))){
+            break;
+        }
+        l = atoi(value) - 1;
+        if (l < 0 || l >= MAX_CACHE_LEVELS ||
+                !readCacheFile(index, "type", type, sizeof(type)) ||
+                strcmp(type, "Instruction") == 0 ||
+                !readCacheFile(index, "size", value, sizeof(value)) ||
+                sscanf(value, "%ld%c", &bytes, &unit) < 1){
+            continue;
+        }
+        cache = &mmCaches[l];
+        cache->level = l + 1;
+        cache->bytes = bytes * (unit == 'K' ? 1024 :
+                unit == 'M' ? 1024 * 1024 : 1);
+        cache->source = "sysfs";
+        if (readCacheFile(index, "ways_of_associativity", value,
+                    sizeof(value))){
+            cache->ways = atoi(value);
+        }
+        if (readCacheFile(index, "coherency_line_size", value,
+                    sizeof(value))){
+            cache->lineBytes = atoi(value);
+        }
+        if (readCacheFile(index, "shared_cpu_list", value, sizeof(value))){
+            cache->sharedBy = countCpus(value);
+        }
+    }
+
+    //Fill the gaps
+    for (l = 0; l < MAX_CACHE_LEVELS; l++){
+        struct CacheLevel *cache = &mmCaches[l];
+        if (cache->bytes <= 0){
+            const long bytes = sysconf(SYSCONF_SIZES[l]);
+            cache->bytes = bytes > 0 ? bytes : FALLBACK_BYTES[l];
+            cache->ways = (int)sysconf(SYSCONF_WAYS[l]);
+            cache->source = bytes > 0 ? "sysconf" : "guess";
+        }
+        cache->level = l + 1;
+        if (cache->ways <= 1){
+            cache->ways = 8;
+        }
+        if (cache->lineBytes <= 0){
+            cache->lineBytes = ALIGN_BYTES;
+        }
+        if (cache->sharedBy <= 0){
+            cache->sharedBy = 1;
+        }
+    }
+    haveCaches = 1;
+} //END: detectCaches()
+
+//Print the data caches
+void printCaches(){
+    int l;
+    detectCaches();
+    for (l = 0; l < MAX_CACHE_LEVELS; l++){
+        const struct CacheLevel *cache = &mmCaches[l];
+        if (cache->bytes > 0){
+            printf("\tL%d: %ld KB, %d-way, %d B lines, shared by %d "
+                    "(%s)\n", cache->level, cache->bytes / 1024, cache->ways,
+                    cache->lineBytes, cache->sharedBy, cache->source);
+        }
+    }
+} //END: printCaches()
+
+//Bytes of a level one block may fill: all but one way, and only this
+//core's share if the level is shared
+static long usableBytes(int level){
+    const struct CacheLevel *cache = &mmCaches[level - 1];
+    return cache->bytes / cache->ways * (cache->ways - 1) / cache->sharedBy;
+} //END: usableBytes()
+
+//Round down to a multiple of step, but at least step
+static int roundDown(long value, int step){
+    return value < step ? step : (int)(value / step * step);
+} //END: roundDown()
+
+//Round up to a multiple of step
+static int roundUp(int value, int step){
+    return (value + step - 1) / step * step;
+} //END: roundUp()
+
+//Size the blocks of mult_tiling_levels() for n x n matrices
+void chooseLevelBlocking(int n){
+    struct LevelBlocking *b = &mmLevels;
+    detectCaches();
+    b->mu = MU;
+    b->nu = NU;
+    //X sliver in L1
+    b->kc = roundDown(usableBytes(1) / (MU * (long)sizeof(double)),
+            DOUBLES_PER_LINE);
+    if (b->kc > n){
+        b->kc = n;
+    }
+    //Y panel in L2
+    b->nc = roundDown(usableBytes(2) / (b->kc * (long)sizeof(double)), NU);
+    if (b->nc > roundUp(n, NU)){
+        b->nc = roundUp(n, NU);
+    }
+    //X block in this core's share of L3, or L2 if there is none
+    b->mc = roundDown((mmCaches[2].bytes > 0 ? usableBytes(3) :
+                usableBytes(2)) / (b->kc * (long)sizeof(double)), MU);
+    if (b->mc > roundUp(n, MU)){
+        b->mc = roundUp(n, MU);
+    }
+} //END: chooseLevelBlocking()
+
+//Model the hit rate of each level for n x n matrices and the current
+//blocks: hitRate[l] is for level l + 1, negative for a level that sees
+//no accesses
+void levelHitRates(int n, double hitRate[3]){
+    const struct LevelBlocking *b = &mmLevels;
+    const double cube = (double)n * n * n, square = (double)n * n;
+    const double line = DOUBLES_PER_LINE;
+    const double slices = (double)((n + b->kc - 1) / b->kc);
+    const double panels = (double)((n + b->nc - 1) / b->nc);
+    const double blocks = (double)((n + b->mc - 1) / b->mc);
+    //Whole matrices that fit a level are there from filling them, and
+    //never miss it
+    const int fitsL2 = 3 * square * sizeof(double) <= usableBytes(2);
+    const int fitsL3 = 3 * square * sizeof(double) <= usableBytes(3);
+    double l1Access, l1Miss, l2Miss, l3Miss;
+
+    //Each k step of a micro-tile loads MU of X and NU of Y; matZ is loaded
+    //once per micro-tile per slice
+    l1Access = cube / b->nu + cube / b->mu + square * slices;
+    //Misses: the Y sliver streams in for every X sliver, the X sliver
+    //once per Y panel, matZ once per slice
+    l1Miss = (cube / b->mu + square * panels + square * slices) / line;
+    //The Y panel comes in once per X block, the X sliver from L3 once per
+    //Y panel, matZ once per slice
+    l2Miss = fitsL2 ? 0.0 :
+        (square * blocks + square * panels + square * slices) / line;
+    //The X block comes in once; matY once per X block and matZ once per
+    //slice unless they fit too
+    l3Miss = fitsL3 ? 0.0 :
+        (square + square * blocks + square * slices) / line;
+
+    hitRate[0] = 1.0 - l1Miss / l1Access;
+    hitRate[1] = l1Miss > 0 ?
+        1.0 - (l2Miss < l1Miss ? l2Miss / l1Miss : 1.0) : -1.0;
+    hitRate[2] = l2Miss > 0 ?
+        1.0 - (l3Miss < l2Miss ? l3Miss / l2Miss : 1.0) : -1.0;
+} //END: levelHitRates()
+
+//Print the blocks of mult_tiling_levels()
+void printLevelBlocking(){
+    printf("\tblocks: micro-tile %d x %d, kc %d (L1), nc %d (L2), "
+            "mc %d (L3)\n", mmLevels.mu, mmLevels.nu, mmLevels.kc,
+            mmLevels.nc, mmLevels.mc);
+} //END: printLevelBlocking()
+
+//Open and start the hit rate counters for this thread; without them,
+//stopLevelCounters() falls back to the model
+void startLevelCounters(){
+    struct perf_event_attr attr;
+    int i;
+    countersOpen = 0;
+    for (i = 0; i < NUM_LEVEL_COUNTERS; i++){
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = LEVEL_COUNTERS[i];
+        attr.disabled = i == 0;         //The whole group starts at once
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        counterFds[i] = syscall(SYS_perf_event_open, &attr, 0, -1,
+                i == 0 ? -1 : counterFds[0], 0);
+        if (counterFds[i] < 0){
+            while (i-- > 0){
+                close(counterFds[i]);
+            }
+            return;
+        }
+    }
+    countersOpen = 1;
+    ioctl(counterFds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(counterFds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+} //END: startLevelCounters()
+
+//Stop the counters and give the hit rates of the run since
+//startLevelCounters(), or model them for n x n matrices if there were no
+//counters
+//@return 1 if the hit rates were measured, 0 if modelled
+int stopLevelCounters(int n, double hitRate[3]){
+    uint64_t values[1 + NUM_LEVEL_COUNTERS];
+    int i, measured = 0;
+    if (countersOpen){
+        ioctl(counterFds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        //One read() of the leader gives the number of counters, then each
+        measured = read(counterFds[0], values, sizeof(values)) ==
+            (ssize_t)sizeof(values) && values[1 + L1_LOADS] > 0;
+        for (i = 0; i < NUM_LEVEL_COUNTERS; i++){
+            close(counterFds[i]);
+        }
+        countersOpen = 0;
+    }
+    if (measured){
+        const double l1Loads = values[1 + L1_LOADS];
+        const double l1Misses = values[1 + L1_MISSES];
+        const double llcLoads = values[1 + LLC_LOADS];
+        const double llcMisses = values[1 + LLC_MISSES];
+        hitRate[0] = 1.0 - l1Misses / l1Loads;
+        hitRate[1] = l1Misses > 0 ?
+            1.0 - (llcLoads < l1Misses ? llcLoads / l1Misses : 1.0) : -1.0;
+        hitRate[2] = llcLoads > 0 ? 1.0 - llcMisses / llcLoads : -1.0;
+    } else {
+        levelHitRates(n, hitRate);
+    }
+    return measured;
+} //END: stopLevelCounters()
+
+//Print hit rates from stopLevelCounters(), saying how they were found;
+//a level that saw no accesses is printed as unused
+void printLevelHitRates(int measured, const double hitRate[3]){
+    int l;
+    printf("\t%s hit rates:",
+            measured ? "measured" : "modelled (no hardware counters)");
+    for (l = 0; l < 3; l++){
+        if (hitRate[l] < 0){
+            printf("%s L%d unused", l > 0 ? "," : "", l + 1);
+        } else {
+            printf("%s L%d %.1f%%", l > 0 ? "," : "", l + 1,
+                    100.0 * hitRate[l]);
+        }
+    }
+    printf("\n");
+} //END: printLevelHitRates()
+
+//matZ[rows x cols] += matX[rows x kc] * matY[kc x cols] for one micro-tile;
+//a full MU x NU tile has constant loops, so its sums stay in registers
+static void microTile(int kc, const double* restrict x,
+        const double* restrict y, double* restrict z, int ld, int rows,
+        int cols){
+    int i, j, p;
+    if (rows == MU && cols == NU){
+        double acc[MU][NU] = {{0.0}};
+        for (p = 0; p < kc; p++){
+            const double* restrict yRow = y + (size_t)p * ld;
+            for (i = 0; i < MU; i++){
+                const double xip = x[(size_t)i * ld + p];
+                for (j = 0; j < NU; j++){
+                    acc[i][j] += xip * yRow[j];
+                }
+            }
+        }
+        for (i = 0; i < MU; i++){
+            for (j = 0; j < NU; j++){
+                z[(size_t)i * ld + j] += acc[i][j];
+            }
+        }
+        return;
+    }
+    for (i = 0; i < rows; i++){
+        for (j = 0; j < cols; j++){
+            double sum = 0.0;
+            for (p = 0; p < kc; p++){
+                sum += x[(size_t)i * ld + p] * y[(size_t)p * ld + j];
+            }
+            z[(size_t)i * ld + j] += sum;
+        }
+    }
+} //END: microTile()
+
+//Matrix multiply blocked for L1, L2 and L3 at once, with the blocks in
+//mmLevels, compute only; adds onto matZ
+void mult_tiling_levels(const double* restrict matX,
+        const double* restrict matY, double* restrict matZ, int ld){
+    const int n = numRow;
+    const struct LevelBlocking b = mmLevels;
+    int pc, ic, jc, ir, jr;
+    for (pc = 0; pc < n; pc += b.kc){
+        const int kc = n - pc < b.kc ? n - pc : b.kc;
+        for (ic = 0; ic < n; ic += b.mc){
+            const int mc = n - ic < b.mc ? n - ic : b.mc;
+            for (jc = 0; jc < numCol; jc += b.nc){
+                const int nc = numCol - jc < b.nc ? numCol - jc : b.nc;
+                for (ir = 0; ir < mc; ir += MU){
+                    const int rows = mc - ir < MU ? mc - ir : MU;
+                    for (jr = 0; jr < nc; jr += NU){
+                        const int cols = nc - jr < NU ? nc - jr : NU;
+                        microTile(kc, &ELEM(matX, ic + ir, pc, ld),
+                                &ELEM(matY, pc, jc + jr, ld),
+                                &ELEM(matZ, ic + ir, jc + jr, ld), ld,
+                                rows, cols);
+                    }
+                }
+            }
+        }
+    }
+} //END: mult_tiling_levels()
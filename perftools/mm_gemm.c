@@ -0,0 +1,84 @@
+// Library entry point of the packed multiply: checks the arguments, scales
+// C by beta, and hands the rest to gemm_packed() in mm_packed.c, which
+// takes care of the transposes and alpha while it packs. See mm_gemm.h.
+//
+// Nothing here touches matrixmult's globals, so the library is just this
+// file and mm_packed.c.
+# include <stdlib.h>
+# include <string.h>
+# include "matrixmult.h"
+# include "mm_gemm.h"
+
+//c = beta * c for an m x n c; beta = 0 clears it, so NaNs in c go too
+static void scaleC(int m, int n, double beta, double *c, int ldc){
+    int i, j;
+    if (beta == 1.0){
+        return;
+    }
+    for (i = 0; i < m; i++){
+        double *cRow = &ELEM(c, i, 0, ldc);
+        if (beta == 0.0){
+            memset(cRow, 0, n * sizeof(double));
+        } else {
+            for (j = 0; j < n; j++){
+                cRow[j] *= beta;
+            }
+        }
+    }
+} //END: scaleC()
+
+int mm_dgemm(enum MMTranspose transA, enum MMTranspose transB,
+        int m, int n, int k, double alpha, const double *a, int lda,
+        const double *b, int ldb, double beta, double *c, int ldc){
+    //Row lengths of A and B as stored
+    const int aCols = transA == MM_TRANS ? m : k;
+    const int bCols = transB == MM_TRANS ? k : n;
+    double *work = NULL;
+
+    if (transA != MM_NO_TRANS && transA != MM_TRANS){
+        return 1;
+    }
+    if (transB != MM_NO_TRANS && transB != MM_TRANS){
+        return 2;
+    }
+    if (m < 0){
+        return 3;
+    }
+    if (n < 0){
+        return 4;
+    }
+    if (k < 0){
+        return 5;
+    }
+    if (lda < (aCols > 1 ? aCols : 1)){
+        return 8;
+    }
+    if (ldb < (bCols > 1 ? bCols : 1)){
+        return 10;
+    }
+    if (ldc < (n > 1 ? n : 1)){
+        return 13;
+    }
+
+    if (m == 0 || n == 0){
+        return 0;
+    }
+    //Allocate before scaling, so running out of memory leaves C as it was
+    if (alpha != 0.0 && k != 0 &&
+            posix_memalign((void **)&work, ALIGN_BYTES,
+                packedWorkspace() * sizeof(double)) != 0){
+        return MM_GEMM_NO_MEMORY;
+    }
+    scaleC(m, n, beta, c, ldc);
+    if (work == NULL){
+        return 0;
+    }
+    gemm_packed(transA == MM_TRANS, transB == MM_TRANS, m, n, k, alpha,
+            a, lda, b, ldb, c, ldc, work);
+    free(work);
+    return 0;
+} //END: mm_dgemm()
+
+const char *mm_gemm_kernel(void){
+    return packedKernelName();
+} //END: mm_gemm_kernel()
@@ -0,0 +1,56 @@
+//Double precision general matrix multiply, built as libmmgemm.a and
+//libmmgemm.so by 'make mm_lib':
+//
+//  C = alpha * op(A) * op(B) + beta * C
+//
+//where op(A) is m x k, op(B) is k x n and C is m x n. Matrices are row
+//major, as in matrixmult: element (i, j) of A is A[i * lda + j]. op(X) is
+//X for MM_NO_TRANS and its transpose for MM_TRANS, so a transposed A is
+//stored k x m. The transpose is taken while packing, never by copying.
+//
+//  mm_dgemm(MM_NO_TRANS, MM_TRANS, m, n, k, 1.0, a, lda, b, ldb,
+//           0.0, c, ldc);      //c = a * b^T
+//
+//Like the BLAS, beta = 0 overwrites C without reading it, and alpha = 0 or
+//k = 0 only scales C. The kernel (AVX-512, AVX2 or scalar) is chosen from
+//the CPU on the first call; MM_ISA forces one. Any number of threads may
+//call mm_dgemm() at once on different C.
+//
+//The library exports only the mm_ names below; everything else it is built
+//from is hidden.
+#ifndef MM_GEMM_H
+#define MM_GEMM_H
+
+#if defined(__GNUC__)
+#define MM_GEMM_API __attribute__((visibility("default")))
+#else
+#define MM_GEMM_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum MMTranspose {
+    MM_NO_TRANS = 0,
+    MM_TRANS = 1
+};
+
+//Returns 0, or the position (from 1) of the first bad argument, having
+//changed nothing: a transpose flag other than the two above, a negative
+//size, or a leading dimension shorter than a row of its matrix. Returns
+//MM_GEMM_NO_MEMORY, again with C unchanged, if the workspace for the
+//packed panels cannot be allocated.
+#define MM_GEMM_NO_MEMORY (-1)
+MM_GEMM_API int mm_dgemm(enum MMTranspose transA, enum MMTranspose transB,
+        int m, int n, int k, double alpha, const double *a, int lda,
+        const double *b, int ldb, double beta, double *c, int ldc);
+
+//Name of the micro-kernel mm_dgemm() runs on this CPU
+MM_GEMM_API const char *mm_gemm_kernel(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
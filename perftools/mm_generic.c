@@ -0,0 +1,228 @@
+// The naive and tiled matrix multiply on contiguous matrices, generic over
+// the element type: float, double, float complex and double complex.
+//
+// Each type gets its own copy of the kernels, stamped out by
+// DEFINE_TYPED_KERNELS() with the element type and its multiply as
+// constants, so every copy is compiled for its own type: single precision
+// moves half the bytes of double. The copy to run is picked at run time
+// by name (findElemType()), once per multiply. The double copy is the
+// one matrixmult runs everywhere else: mult_naive_flat(), tile_flat() and
+// mult_tiling_flat(), below the kernels, only call it, so naive_flat
+// and generic_naive/double benchmark the same code, as do tiling_flat
+// and generic_tiling/double.
+//
+// Results are checked by checkResult() in mm_bench.c, which reads the
+// matrices of any type through get##NAME().
+//
+// Complex numbers are multiplied with the textbook formula rather than
+// with *, which also checks for infinities and NaNs and calls the library
+// when it finds them, and would keep the loop from vectorising. Inputs
+// here are always finite.
+//
+// A complex multiply-add is 8 flops, a real one 2.
+# include <string.h>
+# include <complex.h>
+# include "matrixmult.h"
+
+//Multiply two elements of each type
+#define MUL_REAL(a, b) ((a) * (b))
+#define MUL_COMPLEX_FLOAT(a, b) \
+    CMPLXF(crealf(a) * crealf(b) - cimagf(a) * cimagf(b), \
+           crealf(a) * cimagf(b) + cimagf(a) * crealf(b))
+#define MUL_COMPLEX_DOUBLE(a, b) \
+    CMPLX(creal(a) * creal(b) - cimag(a) * cimag(b), \
+          creal(a) * cimag(b) + cimag(a) * creal(b))
+
+//Make an element from a real and an imaginary part; real types drop the
+//imaginary part
+#define MAKE_REAL(T, re, im) ((T)(re))
+#define MAKE_COMPLEX(T, re, im) ((T)(re) + (T)(im) * I)
+
+//Define every element type: the suffix of its kernels, the C type, its
+//name, flops per multiply-add, the largest scaled error accepted, and how
+//to multiply and make elements
+#define FOR_EACH_ELEM_TYPE(TYPE) \
+    TYPE(Float,         float,          "float",          2, 1e-4,  \
+         MUL_REAL,           MAKE_REAL)                             \
+    TYPE(Double,        double,         "double",         2, 1e-10, \
+         MUL_REAL,           MAKE_REAL)                             \
+    TYPE(ComplexFloat,  float complex,  "complex_float",  8, 1e-4,  \
+         MUL_COMPLEX_FLOAT,  MAKE_COMPLEX)                          \
+    TYPE(ComplexDouble, double complex, "complex_double", 8, 1e-10, \
+         MUL_COMPLEX_DOUBLE, MAKE_COMPLEX)
+
+//Stamp out the kernels of one element type
+#define DEFINE_TYPED_KERNELS(NAME, T, MUL, MAKE) \
+static void fill##NAME(int n, void *vx, void *vy, void *vz, int ld, \
+        double (*value)(int which, int i, int j)){ \
+    T *x = vx, *y = vy, *z = vz; \
+    int i, j; \
+    for (i = 0; i < n; i++){ \
+        for (j = 0; j < n; j++){ \
+            x[(size_t)i * ld + j] = MAKE(T, value(0, i, j), value(3, i, j)); \
+            y[(size_t)i * ld + j] = MAKE(T, value(1, i, j), value(4, i, j)); \
+            z[(size_t)i * ld + j] = 0; \
+        } \
+    } \
+} \
+\
+static void naive##NAME(int n, const void *vx, const void *vy, void *vz, \
+        int ld){ \
+    const T* restrict x = vx; \
+    const T* restrict y = vy; \
+    T* restrict z = vz; \
+    int i, j, k; \
+    for (i = 0; i < n; i++){ \
+        for (j = 0; j < n; j++){ \
+            T sum = 0; \
+            for (k = 0; k < n; k++){ \
+                sum = sum + MUL(ELEM(x, i, k, ld), ELEM(y, k, j, ld)); \
+            } \
+            ELEM(z, i, j, ld) = sum; \
+        } \
+    } \
+} \
+\
+/* Rows t_r up to row_end of the t_c column tile of z, as tile_flat() */ \
+static void tile##NAME(int n, const T* restrict x, const T* restrict y, \
+        T* restrict z, int ld, int t_r, int row_end, int t_c){ \
+    int row, col, prod; \
+    int t_prod; \
+    const int unroll = mmTile.unroll; \
+    const int col_end = t_c + mmTile.cols < n ? t_c + mmTile.cols : n; \
+    for (t_prod = 0; t_prod < n; t_prod += mmTile.prods){ \
+        const int prod_end = t_prod + mmTile.prods < n ? \
+            t_prod + mmTile.prods : n; \
+        for (row = t_r; row < row_end; row++){ \
+            col = t_c; \
+            for (; unroll >= 4 && col + 4 <= col_end; col += 4){ \
+                T sum0 = ELEM(z, row, col, ld); \
+                T sum1 = ELEM(z, row, col + 1, ld); \
+                T sum2 = ELEM(z, row, col + 2, ld); \
+                T sum3 = ELEM(z, row, col + 3, ld); \
+                for (prod = t_prod; prod < prod_end; prod++){ \
+                    const T xv = ELEM(x, row, prod, ld); \
+                    const T* restrict yv = &ELEM(y, prod, col, ld); \
+                    sum0 = sum0 + MUL(xv, yv[0]); \
+                    sum1 = sum1 + MUL(xv, yv[1]); \
+                    sum2 = sum2 + MUL(xv, yv[2]); \
+                    sum3 = sum3 + MUL(xv, yv[3]); \
+                } \
+                ELEM(z, row, col, ld) = sum0; \
+                ELEM(z, row, col + 1, ld) = sum1; \
+                ELEM(z, row, col + 2, ld) = sum2; \
+                ELEM(z, row, col + 3, ld) = sum3; \
+            } \
+            for (; unroll >= 2 && col + 2 <= col_end; col += 2){ \
+                T sum0 = ELEM(z, row, col, ld); \
+                T sum1 = ELEM(z, row, col + 1, ld); \
+                for (prod = t_prod; prod < prod_end; prod++){ \
+                    const T xv = ELEM(x, row, prod, ld); \
+                    sum0 = sum0 + MUL(xv, ELEM(y, prod, col, ld)); \
+                    sum1 = sum1 + MUL(xv, ELEM(y, prod, col + 1, ld)); \
+                } \
+                ELEM(z, row, col, ld) = sum0; \
+                ELEM(z, row, col + 1, ld) = sum1; \
+            } \
+            for (; col < col_end; col++){ \
+                T sum = ELEM(z, row, col, ld); \
+                for (prod = t_prod; prod < prod_end; prod++){ \
+                    sum = sum + MUL(ELEM(x, row, prod, ld), \
+                            ELEM(y, prod, col, ld)); \
+                } \
+                ELEM(z, row, col, ld) = sum; \
+            } \
+        } \
+    } \
+} \
+\
+static void tiling##NAME(int n, const void *vx, const void *vy, void *vz, \
+        int ld){ \
+    int t_r, t_c; \
+    for (t_r = 0; t_r < n; t_r += mmTile.rows){ \
+        const int row_end = t_r + mmTile.rows < n ? t_r + mmTile.rows : n; \
+        for (t_c = 0; t_c < n; t_c += mmTile.cols){ \
+            tile##NAME(n, vx, vy, vz, ld, t_r, row_end, t_c); \
+        } \
+    } \
+} \
+\
+static double complex get##NAME(const void *mat, size_t index){ \
+    return ((const T *)mat)[index]; \
+}
+
+#define TYPED_KERNELS(NAME, T, STRING, FLOPS, TOL, MUL, MAKE) \
+    DEFINE_TYPED_KERNELS(NAME, T, MUL, MAKE)
+FOR_EACH_ELEM_TYPE(TYPED_KERNELS)
+
+//The double kernels of the rest of matrixmult are the double copy, on the
+//numRow x numRow matrices
+
+//Naive matrix multiply on the contiguous matrices, compute only: same loops
+//as mult_naive, but rows are found by arithmetic instead of a pointer load,
+//and restrict lets the compiler keep matZ[i][j] in a register
+void mult_naive_flat(const double* restrict matX,
+        const double* restrict matY, double* restrict matZ, int ld){
+    naiveDouble(numRow, matX, matY, matZ, ld);
+} //END: mult_naive_flat()
+
+//Rows t_r up to row_end of the t_c column tile of matZ on the contiguous
+//matrices: every t_prod tile of matX's rows times matY's columns, added
+//onto matZ. Only these rows of the tile of matZ are written, so different
+//tiles, or bands of rows of one tile, can be computed at the same time.
+//
+//With mmTile.unroll of 2 or 4, that many neighbouring columns of matZ are
+//summed together, so each element of matX is loaded once for all of them
+//and matY is read a few elements of a row at a time. Each element is still
+//summed over prod in the same order, so the result does not change.
+void tile_flat(const double* restrict matX, const double* restrict matY,
+        double* restrict matZ, int ld, int t_r, int row_end, int t_c){
+    tileDouble(numRow, matX, matY, matZ, ld, t_r, row_end, t_c);
+} //END: tile_flat()
+
+//Matrix multiply with tiling on the contiguous matrices, compute only: same
+//tiles as mult_tiling, with the tile bounds worked out once per tile
+//instead of calling fmin() on every iteration
+void mult_tiling_flat(const double* restrict matX,
+        const double* restrict matY, double* restrict matZ, int ld){
+    tilingDouble(numRow, matX, matY, matZ, ld);
+} //END: mult_tiling_flat()
+
+#define TYPED_ENTRY(NAME, T, STRING, FLOPS, TOL, MUL, MAKE) \
+    { STRING, sizeof(T), FLOPS, TOL, fill##NAME, naive##NAME, \
+      tiling##NAME, get##NAME },
+static const struct ElemType ELEM_TYPES[] = {
+    FOR_EACH_ELEM_TYPE(TYPED_ENTRY)
+};
+
+//Number of element types, and the i-th
+int numElemTypes(){
+    return (int)(sizeof(ELEM_TYPES) / sizeof(ELEM_TYPES[0]));
+} //END: numElemTypes()
+
+const struct ElemType *elemType(int i){
+    return &ELEM_TYPES[i];
+} //END: elemType()
+
+//Find an element type by name, or NULL
+const struct ElemType *findElemType(const char *name){
+    int i;
+    for (i = 0; i < numElemTypes(); i++){
+        if (strcmp(name, ELEM_TYPES[i].name) == 0){
+            return &ELEM_TYPES[i];
+        }
+    }
+    return NULL;
+} //END: findElemType()
+
+//Leading dimension, in elements, for ncol elements of size bytes: like
+//leadingDim(), a whole number of cache lines that is not a multiple of
+//CRITICAL_STRIDE
+int typedLeadingDim(int ncol, size_t size){
+    size_t bytes = (ncol * size + ALIGN_BYTES - 1) / ALIGN_BYTES *
+        ALIGN_BYTES;
+    if (bytes % CRITICAL_STRIDE == 0){
+        bytes = bytes + ALIGN_BYTES;
+    }
+    return (int)(bytes / size);
+} //END: typedLeadingDim()
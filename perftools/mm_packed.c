@@ -0,0 +1,372 @@
+// Packed-panel matrix multiply for matrixmult, in the style of GotoBLAS and
+// BLIS.
+//
+// matZ is split into blocks so each piece of data stays in one level of
+// cache while it is reused:
+//
+//   for each NC-wide column panel of matY and matZ       (jc loop)
+//     for each KC-deep slice of the inner dimension      (pc loop)
+//       pack matY[pc.., jc..] into KC x NC, NR columns at a time
+//       for each MC-tall row block of matX and matZ      (ic loop)
+//         pack matX[ic.., pc..] into MC x KC, MR rows at a time
+//         for each NR-wide micro-panel of packed Y       (jr loop)
+//           for each MR-tall micro-panel of packed X     (ir loop)
+//             micro-kernel: matZ[MR x NR] += X panel * Y panel
+//
+// Packing copies each panel into a contiguous, aligned buffer in exactly
+// the order the micro-kernel reads it, so the kernel streams through memory
+// with unit stride no matter what the leading dimensions are, and edge
+// panels are padded with zeros so the kernel always does a full tile.
+// It is also where gemm_packed() applies op() and alpha: a transposed
+// operand is packed by reading it along the other index, and X is scaled
+// as it is packed, so neither costs a pass of its own.
+//
+// The micro-kernel keeps the whole MR x NR tile of matZ in vector registers
+// and does one fused multiply-add per register per k: it broadcasts one
+// element of the X panel and multiplies it by NR/VL vectors of the Y panel.
+// Which kernel runs is chosen once at run time from the CPU: AVX-512 (8x24),
+// AVX2 with FMA (6x8), or portable C (4x4). Setting MM_ISA to avx512, avx2
+// or scalar forces one, if the CPU runs it. Off x86, or with a compiler
+// without target attributes, only the portable kernel is built.
+# include <stdlib.h>
+# include <stdio.h>
+# include <string.h>
+# include <stdatomic.h>
+# include "matrixmult.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD
+# include <immintrin.h>
+#endif
+
+#define MAX_MR 8        //Largest tile of any micro-kernel
+#define MAX_NR 24
+
+//Block sizes; multiples of every MR and NR
+struct Blocking mmBlocking = { 144, 256, 2016 };
+
+//A micro-kernel: c[MR x NR] += a * b, where a is an MR x kc panel packed
+//k-major and b a kc x NR panel packed k-major
+struct MicroKernel {
+    const char *name;
+    int mr, nr;
+    void (*run)(int kc, const double *restrict a, const double *restrict b,
+            double *restrict c, int ldc);
+};
+
+//Portable 4x4 micro-kernel
+static void microScalar(int kc, const double *restrict a,
+        const double *restrict b, double *restrict c, int ldc){
+    double acc[4][4] = {{0.0}};
+    int i, j, k;
+    for (k = 0; k < kc; k++){
+        for (i = 0; i < 4; i++){
+            for (j = 0; j < 4; j++){
+                acc[i][j] += a[k * 4 + i] * b[k * 4 + j];
+            }
+        }
+    }
+    for (i = 0; i < 4; i++){
+        for (j = 0; j < 4; j++){
+            c[(size_t)i * ldc + j] += acc[i][j];
+        }
+    }
+} //END: microScalar()
+
+#ifdef HAVE_X86_SIMD
+
+//AVX2 6x8 micro-kernel: 12 accumulators, 2 loads of b, 1 broadcast
+__attribute__((target("avx2,fma")))
+static void microAvx2(int kc, const double *restrict a,
+        const double *restrict b, double *restrict c, int ldc){
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+    __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+    int k;
+    for (k = 0; k < kc; k++){
+        const __m256d b0 = _mm256_load_pd(b + k * 8);
+        const __m256d b1 = _mm256_load_pd(b + k * 8 + 4);
+        __m256d ai;
+        ai = _mm256_broadcast_sd(a + k * 6 + 0);
+        c00 = _mm256_fmadd_pd(ai, b0, c00); c01 = _mm256_fmadd_pd(ai, b1, c01);
+        ai = _mm256_broadcast_sd(a + k * 6 + 1);
+        c10 = _mm256_fmadd_pd(ai, b0, c10); c11 = _mm256_fmadd_pd(ai, b1, c11);
+        ai = _mm256_broadcast_sd(a + k * 6 + 2);
+        c20 = _mm256_fmadd_pd(ai, b0, c20); c21 = _mm256_fmadd_pd(ai, b1, c21);
+        ai = _mm256_broadcast_sd(a + k * 6 + 3);
+        c30 = _mm256_fmadd_pd(ai, b0, c30); c31 = _mm256_fmadd_pd(ai, b1, c31);
+        ai = _mm256_broadcast_sd(a + k * 6 + 4);
+        c40 = _mm256_fmadd_pd(ai, b0, c40); c41 = _mm256_fmadd_pd(ai, b1, c41);
+        ai = _mm256_broadcast_sd(a + k * 6 + 5);
+        c50 = _mm256_fmadd_pd(ai, b0, c50); c51 = _mm256_fmadd_pd(ai, b1, c51);
+    }
+#define ADD_ROW_AVX2(i, lo, hi) \
+    _mm256_storeu_pd(c + (size_t)(i) * ldc, \
+            _mm256_add_pd(_mm256_loadu_pd(c + (size_t)(i) * ldc), lo)); \
+    _mm256_storeu_pd(c + (size_t)(i) * ldc + 4, \
+            _mm256_add_pd(_mm256_loadu_pd(c + (size_t)(i) * ldc + 4), hi));
+    ADD_ROW_AVX2(0, c00, c01)
+    ADD_ROW_AVX2(1, c10, c11)
+    ADD_ROW_AVX2(2, c20, c21)
+    ADD_ROW_AVX2(3, c30, c31)
+    ADD_ROW_AVX2(4, c40, c41)
+    ADD_ROW_AVX2(5, c50, c51)
+#undef ADD_ROW_AVX2
+} //END: microAvx2()
+
+//AVX-512 8x24 micro-kernel: 24 accumulators, 3 loads of b, 1 broadcast
+__attribute__((target("avx512f")))
+static void microAvx512(int kc, const double *restrict a,
+        const double *restrict b, double *restrict c, int ldc){
+    __m512d acc[8][3];
+    int i, k;
+    for (i = 0; i < 8; i++){
+        acc[i][0] = acc[i][1] = acc[i][2] = _mm512_setzero_pd();
+    }
+    for (k = 0; k < kc; k++){
+        const __m512d b0 = _mm512_load_pd(b + k * 24);
+        const __m512d b1 = _mm512_load_pd(b + k * 24 + 8);
+        const __m512d b2 = _mm512_load_pd(b + k * 24 + 16);
+        //Constant trip count, so this unrolls and acc stays in registers
+#pragma GCC unroll 8
+        for (i = 0; i < 8; i++){
+            const __m512d ai = _mm512_set1_pd(a[k * 8 + i]);
+            acc[i][0] = _mm512_fmadd_pd(ai, b0, acc[i][0]);
+            acc[i][1] = _mm512_fmadd_pd(ai, b1, acc[i][1]);
+            acc[i][2] = _mm512_fmadd_pd(ai, b2, acc[i][2]);
+        }
+    }
+    for (i = 0; i < 8; i++){
+        double *row = c + (size_t)i * ldc;
+        _mm512_storeu_pd(row, _mm512_add_pd(_mm512_loadu_pd(row), acc[i][0]));
+        _mm512_storeu_pd(row + 8,
+                _mm512_add_pd(_mm512_loadu_pd(row + 8), acc[i][1]));
+        _mm512_storeu_pd(row + 16,
+                _mm512_add_pd(_mm512_loadu_pd(row + 16), acc[i][2]));
+    }
+} //END: microAvx512()
+
+#endif
+
+//Best first
+static const struct MicroKernel KERNELS[] = {
+#ifdef HAVE_X86_SIMD
+    { "avx512", 8, 24, microAvx512 },
+    { "avx2",   6, 8,  microAvx2 },
+#endif
+    { "scalar", 4, 4,  microScalar },
+};
+#define NUM_KERNELS ((int)(sizeof(KERNELS) / sizeof(KERNELS[0])))
+
+//The micro-kernel, set by the first pickKernel(); threads making that call
+//at the same time all choose the same kernel, so whichever store lands last
+//changes nothing
+static _Atomic(const struct MicroKernel *) chosenKernel = NULL;
+
+//Whether this CPU has the instructions of a micro-kernel
+static int cpuRuns(const struct MicroKernel *k){
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (strcmp(k->name, "avx512") == 0){
+        return __builtin_cpu_supports("avx512f");
+    }
+    if (strcmp(k->name, "avx2") == 0){
+        return __builtin_cpu_supports("avx2") &&
+            __builtin_cpu_supports("fma");
+    }
+#else
+    (void)k;
+#endif
+    return 1;
+} //END: cpuRuns()
+
+//Choose the micro-kernel: MM_ISA if set and the CPU runs it, else the best
+//the CPU runs
+static const struct MicroKernel *chooseKernel(){
+    const char *forced = getenv("MM_ISA");
+    int i;
+    if (forced != NULL){
+        for (i = 0; i < NUM_KERNELS; i++){
+            if (strcmp(forced, KERNELS[i].name) == 0){
+                break;
+            }
+        }
+        if (i == NUM_KERNELS){
+            fprintf(stderr, "Unknown MM_ISA %s, choosing from the CPU\n",
+                    forced);
+        } else if (!cpuRuns(&KERNELS[i])){
+            fprintf(stderr, "This CPU cannot run MM_ISA %s, choosing from "
+                    "the CPU\n", forced);
+        } else {
+            return &KERNELS[i];
+        }
+    }
+    //The last kernel is the portable one, which every CPU runs
+    for (i = 0; !cpuRuns(&KERNELS[i]); i++){
+    }
+    return &KERNELS[i];
+} //END: chooseKernel()
+
+//The micro-kernel to run, chosen on the first call
+static const struct MicroKernel *pickKernel(){
+    const struct MicroKernel *kernel =
+        atomic_load_explicit(&chosenKernel, memory_order_acquire);
+    if (kernel == NULL){
+        kernel = chooseKernel();
+        atomic_store_explicit(&chosenKernel, kernel, memory_order_release);
+    }
+    return kernel;
+} //END: pickKernel()
+
+//Name of the micro-kernel mult_packed uses
+const char *packedKernelName(){
+    return pickKernel()->name;
+} //END: packedKernelName()
+
+//Address of element (i, j) of op(x): x itself, or its transpose if trans
+static const double *opElem(const double *x, int ldx, int trans, int i,
+        int j){
+    return trans ? &ELEM(x, j, i, ldx) : &ELEM(x, i, j, ldx);
+} //END: opElem()
+
+//Pack rows [0, mc) and columns [0, kc) of op(x), times alpha, into MR-row
+//panels, k-major, padding the last panel with zeros. A transposed x is
+//read along its rows here, so it is never copied out first.
+static void packX(int mc, int kc, const double *x, int ldx, int trans,
+        double alpha, double *packed, int mr){
+    int p, i, k;
+    for (p = 0; p < mc; p += mr){
+        const int rows = mc - p < mr ? mc - p : mr;
+        for (k = 0; k < kc; k++){
+            for (i = 0; i < rows; i++){
+                packed[k * mr + i] = alpha * *opElem(x, ldx, trans, p + i, k);
+            }
+            for (; i < mr; i++){
+                packed[k * mr + i] = 0.0;
+            }
+        }
+        packed += (size_t)mr * kc;
+    }
+} //END: packX()
+
+//Pack rows [0, kc) and columns [0, nc) of op(y) into NR-column panels,
+//k-major, padding the last panel with zeros
+static void packY(int kc, int nc, const double *y, int ldy, int trans,
+        double *packed, int nr){
+    int q, j, k;
+    for (q = 0; q < nc; q += nr){
+        const int cols = nc - q < nr ? nc - q : nr;
+        for (k = 0; k < kc; k++){
+            if (trans){
+                for (j = 0; j < cols; j++){
+                    packed[k * nr + j] = ELEM(y, q + j, k, ldy);
+                }
+            } else {
+                const double *row = &ELEM(y, k, q, ldy);
+                for (j = 0; j < cols; j++){
+                    packed[k * nr + j] = row[j];
+                }
+            }
+            for (; j < nr; j++){
+                packed[k * nr + j] = 0.0;
+            }
+        }
+        packed += (size_t)nr * kc;
+    }
+} //END: packY()
+
+//Run the micro-kernel on a tile that may be cut off by the edge of matZ:
+//full tiles go straight to matZ, partial ones through a scratch tile
+static void runTile(const struct MicroKernel *kernel, int kc,
+        const double *a, const double *b, double *z, int ldz, int rows,
+        int cols){
+    double scratch[MAX_MR * MAX_NR] __attribute__((aligned(ALIGN_BYTES)));
+    int i, j;
+    if (rows == kernel->mr && cols == kernel->nr){
+        kernel->run(kc, a, b, z, ldz);
+        return;
+    }
+    memset(scratch, 0, sizeof(scratch));
+    kernel->run(kc, a, b, scratch, kernel->nr);
+    for (i = 0; i < rows; i++){
+        for (j = 0; j < cols; j++){
+            z[(size_t)i * ldz + j] += scratch[i * kernel->nr + j];
+        }
+    }
+} //END: runTile()
+
+//Doubles in the packed X block, rounded up to whole panels and lines
+static size_t packedXDoubles(){
+    const size_t doubles = (size_t)(mmBlocking.mc + MAX_MR) * mmBlocking.kc;
+    return (doubles + DOUBLES_PER_LINE - 1) / DOUBLES_PER_LINE *
+        DOUBLES_PER_LINE;
+} //END: packedXDoubles()
+
+//Doubles of workspace mult_packed_ws() needs with the current blocking
+size_t packedWorkspace(){
+    const size_t doubles = (size_t)(mmBlocking.nc + MAX_NR) * mmBlocking.kc;
+    return packedXDoubles() + (doubles + DOUBLES_PER_LINE - 1) /
+        DOUBLES_PER_LINE * DOUBLES_PER_LINE;
+} //END: packedWorkspace()
+
+//matZ += matX * matY for an m x k matX and a k x n matY, with packed panels
+//and the micro-kernel picked for this CPU
+void mult_packed(int m, int n, int k, const double *matX, int ldx,
+        const double *matY, int ldy, double *matZ, int ldz){
+    double *work;
+    if (posix_memalign((void **)&work, ALIGN_BYTES,
+                packedWorkspace() * sizeof(double)) != 0){
+        printf("Out of memory for the packed panels\n");
+        exit(1);
+    }
+    mult_packed_ws(m, n, k, matX, ldx, matY, ldy, matZ, ldz, work);
+    free(work);
+} //END: mult_packed()
+
+//mult_packed() packing into work, ALIGN_BYTES aligned and
+//packedWorkspace() doubles long, so it allocates nothing
+void mult_packed_ws(int m, int n, int k, const double *matX, int ldx,
+        const double *matY, int ldy, double *matZ, int ldz, double *work){
+    gemm_packed(0, 0, m, n, k, 1.0, matX, ldx, matY, ldy, matZ, ldz, work);
+} //END: mult_packed_ws()
+
+//matZ += alpha * op(matX) * op(matY) for an m x k op(matX) and a k x n
+//op(matY), where op() transposes its matrix if transX or transY is set;
+//work is as for mult_packed_ws()
+void gemm_packed(int transX, int transY, int m, int n, int k, double alpha,
+        const double *matX, int ldx, const double *matY, int ldy,
+        double *matZ, int ldz, double *work){
+    const int mc = mmBlocking.mc, kc = mmBlocking.kc, nc = mmBlocking.nc;
+    double *packedX = work, *packedY = work + packedXDoubles();
+    const struct MicroKernel *kernel = pickKernel();
+    int jc, pc, ic, jr, ir;
+
+    for (jc = 0; jc < n; jc += nc){
+        const int ncCur = n - jc < nc ? n - jc : nc;
+        for (pc = 0; pc < k; pc += kc){
+            const int kcCur = k - pc < kc ? k - pc : kc;
+            packY(kcCur, ncCur, opElem(matY, ldy, transY, pc, jc), ldy,
+                    transY, packedY, kernel->nr);
+            for (ic = 0; ic < m; ic += mc){
+                const int mcCur = m - ic < mc ? m - ic : mc;
+                packX(mcCur, kcCur, opElem(matX, ldx, transX, ic, pc), ldx,
+                        transX, alpha, packedX, kernel->mr);
+                for (jr = 0; jr < ncCur; jr += kernel->nr){
+                    const int cols = ncCur - jr < kernel->nr ?
+                        ncCur - jr : kernel->nr;
+                    for (ir = 0; ir < mcCur; ir += kernel->mr){
+                        const int rows = mcCur - ir < kernel->mr ?
+                            mcCur - ir : kernel->mr;
+                        runTile(kernel, kcCur, packedX + (size_t)ir * kcCur,
+                                packedY + (size_t)jr * kcCur,
+                                &ELEM(matZ, ic + ir, jc + jr, ldz), ldz,
+                                rows, cols);
+                    }
+                }
+            }
+        }
+    }
+} //END: gemm_packed()
@@ -0,0 +1,189 @@
+// Strassen-Winograd matrix multiply for matrixmult.
+//
+// Each level splits the n x n matrices into h x h quarters (h = n/2) and
+// forms the product from 7 multiplies of quarters instead of 8, with the
+// 15 additions of Winograd's variant:
+//
+//   S1 = X21 + X22   S2 = S1 - X11   S3 = X11 - X21   S4 = X12 - S2
+//   T1 = Y12 - Y11   T2 = Y22 - T1   T3 = Y22 - Y12   T4 = T2 - Y21
+//   P1 = X11 Y11  P2 = X12 Y21  P3 = S4 Y22  P4 = X22 T4
+//   P5 = S1 T1    P6 = S2 T2    P7 = S3 T3
+//   Z11 = P1 + P2          U2 = P1 + P6      U3 = U2 + P7
+//   Z12 = U2 + P5 + P3     Z21 = U3 - P4     Z22 = U3 + P5
+//
+// so the work is O(n^2.81) until the quarters are mmCrossover or smaller,
+// where the packed classical multiply is faster.
+//
+// The sums and products go into the quarters of matZ and three h x h
+// temporaries per level (the schedule is in strassenLevel()). All of them,
+// and the packing buffers of mult_packed_ws(), come from one workspace
+// sized by strassenWorkspace() and handed out like a stack, so the
+// recursion never calls malloc.
+//
+// An odd n is peeled: the even n - 1 leading part recurses, and the last
+// row and column are fixed up with O(n^2) classical work, so any size works
+// without padding.
+//
+// Strassen's rounding error grows faster with n than the classical one
+// (bounded normwise rather than elementwise); matrix_mult_strassen() and
+// the benchmark report it against the classical result.
+# include <stdlib.h>
+# include <stdio.h>
+# include <string.h>
+# include "matrixmult.h"
+
+int mmCrossover = STRASSEN_CROSSOVER;   //Largest size not split again
+
+//Doubles of one h x h temporary, rows leadingDim(h) apart so each starts on
+//a cache line
+static size_t tempDoubles(int h){
+    return (size_t)h * leadingDim(h);
+} //END: tempDoubles()
+
+//Doubles of workspace the recursion takes below size n, not counting the
+//packing buffers
+static size_t levelWorkspace(int n){
+    if (n <= mmCrossover){
+        return 0;
+    }
+    if (n % 2 == 1){
+        return levelWorkspace(n - 1);
+    }
+    return 3 * tempDoubles(n / 2) + levelWorkspace(n / 2);
+} //END: levelWorkspace()
+
+//Doubles of workspace mult_strassen_ws() needs for n x n matrices
+size_t strassenWorkspace(int n){
+    return packedWorkspace() + levelWorkspace(n);
+} //END: strassenWorkspace()
+
+//c = a + sign * b for h x h matrices; c may be a or b
+static void addScaled(int h, const double *a, int lda, const double *b,
+        int ldb, double sign, double *c, int ldc){
+    int i, j;
+    for (i = 0; i < h; i++){
+        const double *aRow = a + (size_t)i * lda;
+        const double *bRow = b + (size_t)i * ldb;
+        double *cRow = c + (size_t)i * ldc;
+        for (j = 0; j < h; j++){
+            cRow[j] = aRow[j] + sign * bRow[j];
+        }
+    }
+} //END: addScaled()
+
+//Recursive step: z = x * y for n x n matrices; work holds the packing
+//buffers (packedWorkspace() doubles), and stack the temporaries
+static void strassenLevel(int n, const double *x, int ldx, const double *y,
+        int ldy, double *z, int ldz, double *work, double *stack);
+
+//One even level, using the quarters of z and three temporaries from stack
+static void strassenEven(int n, const double *x, int ldx, const double *y,
+        int ldy, double *z, int ldz, double *work, double *stack){
+    const int h = n / 2, ldt = leadingDim(h);
+    const double *x11 = x, *x12 = x + h;
+    const double *x21 = x + (size_t)h * ldx, *x22 = x21 + h;
+    const double *y11 = y, *y12 = y + h;
+    const double *y21 = y + (size_t)h * ldy, *y22 = y21 + h;
+    double *z11 = z, *z12 = z + h;
+    double *z21 = z + (size_t)h * ldz, *z22 = z21 + h;
+    double *s = stack, *t = s + tempDoubles(h), *p = t + tempDoubles(h);
+    double *next = p + tempDoubles(h);
+
+    addScaled(h, x11, ldx, x21, ldx, -1.0, s, ldt);            //S3
+    addScaled(h, y22, ldy, y12, ldy, -1.0, t, ldt);            //T3
+    strassenLevel(h, s, ldt, t, ldt, z21, ldz, work, next);    //P7
+    addScaled(h, x21, ldx, x22, ldx, 1.0, s, ldt);             //S1
+    addScaled(h, y12, ldy, y11, ldy, -1.0, t, ldt);            //T1
+    strassenLevel(h, s, ldt, t, ldt, z22, ldz, work, next);    //P5
+    addScaled(h, s, ldt, x11, ldx, -1.0, s, ldt);              //S2
+    addScaled(h, y22, ldy, t, ldt, -1.0, t, ldt);              //T2
+    strassenLevel(h, s, ldt, t, ldt, z12, ldz, work, next);    //P6
+    addScaled(h, x12, ldx, s, ldt, -1.0, s, ldt);              //S4
+    strassenLevel(h, s, ldt, y22, ldy, p, ldt, work, next);    //P3
+    strassenLevel(h, x11, ldx, y11, ldy, z11, ldz, work, next);//P1
+    addScaled(h, z11, ldz, z12, ldz, 1.0, z12, ldz);           //U2
+    addScaled(h, z12, ldz, z21, ldz, 1.0, z21, ldz);           //U3
+    addScaled(h, z12, ldz, z22, ldz, 1.0, z12, ldz);           //U2 + P5
+    addScaled(h, z21, ldz, z22, ldz, 1.0, z22, ldz);           //Z22
+    addScaled(h, z12, ldz, p, ldt, 1.0, z12, ldz);             //Z12
+    addScaled(h, t, ldt, y21, ldy, -1.0, t, ldt);              //T4
+    strassenLevel(h, x22, ldx, t, ldt, p, ldt, work, next);    //P4
+    addScaled(h, z21, ldz, p, ldt, -1.0, z21, ldz);            //Z21
+    strassenLevel(h, x12, ldx, y21, ldy, p, ldt, work, next);  //P2
+    addScaled(h, z11, ldz, p, ldt, 1.0, z11, ldz);             //Z11
+} //END: strassenEven()
+
+//An odd level: the leading n - 1 part recursively, then the last column
+//and row classically
+static void strassenOdd(int n, const double *x, int ldx, const double *y,
+        int ldy, double *z, int ldz, double *work, double *stack){
+    const int m = n - 1;
+    int i, j, k;
+
+    strassenLevel(m, x, ldx, y, ldy, z, ldz, work, stack);
+    //Z11 += x12 * y21, the outer product of X's last column and Y's last
+    //row
+    for (i = 0; i < m; i++){
+        const double xim = x[(size_t)i * ldx + m];
+        double *zRow = z + (size_t)i * ldz;
+        const double *yRow = y + (size_t)m * ldy;
+        for (j = 0; j < m; j++){
+            zRow[j] += xim * yRow[j];
+        }
+    }
+    //Last column: z12 = X1* y*2
+    for (i = 0; i < m; i++){
+        double sum = 0.0;
+        for (k = 0; k < n; k++){
+            sum += x[(size_t)i * ldx + k] * y[(size_t)k * ldy + m];
+        }
+        z[(size_t)i * ldz + m] = sum;
+    }
+    //Last row: z2* = x2* Y
+    memset(z + (size_t)m * ldz, 0, n * sizeof(double));
+    for (k = 0; k < n; k++){
+        const double xmk = x[(size_t)m * ldx + k];
+        const double *yRow = y + (size_t)k * ldy;
+        double *zRow = z + (size_t)m * ldz;
+        for (j = 0; j < n; j++){
+            zRow[j] += xmk * yRow[j];
+        }
+    }
+} //END: strassenOdd()
+
+static void strassenLevel(int n, const double *x, int ldx, const double *y,
+        int ldy, double *z, int ldz, double *work, double *stack){
+    int i;
+    if (n <= mmCrossover){
+        //Classical from here down
+        for (i = 0; i < n; i++){
+            memset(z + (size_t)i * ldz, 0, n * sizeof(double));
+        }
+        mult_packed_ws(n, n, n, x, ldx, y, ldy, z, ldz, work);
+    } else if (n % 2 == 1){
+        strassenOdd(n, x, ldx, y, ldy, z, ldz, work, stack);
+    } else {
+        strassenEven(n, x, ldx, y, ldy, z, ldz, work, stack);
+    }
+} //END: strassenLevel()
+
+//matZ = matX * matY for n x n matrices, in the caller's workspace of
+//strassenWorkspace(n) doubles
+void mult_strassen_ws(int n, const double *matX, int ldx,
+        const double *matY, int ldy, double *matZ, int ldz, double *work){
+    strassenLevel(n, matX, ldx, matY, ldy, matZ, ldz, work,
+            work + packedWorkspace());
+} //END: mult_strassen_ws()
+
+//matZ = matX * matY for n x n matrices, allocating the workspace once
+void mult_strassen(int n, const double *matX, int ldx, const double *matY,
+        int ldy, double *matZ, int ldz){
+    double *work;
+    if (posix_memalign((void **)&work, ALIGN_BYTES,
+                strassenWorkspace(n) * sizeof(double)) != 0){
+        printf("Out of memory for the Strassen workspace\n");
+        exit(1);
+    }
+    mult_strassen_ws(n, matX, ldx, matY, ldy, matZ, ldz, work);
+    free(work);
+} //END: mult_strassen()
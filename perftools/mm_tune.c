@@ -0,0 +1,392 @@
+// Block-size autotuner for matrixmult.
+//
+// The best block sizes depend on the caches of the CPU and on the size of
+// the matrices, so no one value (362, or the 682 tried before it) suits
+// every machine. With -T the benchmark searches them for each size:
+//
+//   tiling  rows x cols x prods tiles, each edge one of TILE_EDGES, summing
+//           1, 2 or 4 columns of matZ at a time (mmTile)
+//   packed  mc x kc x nc blocks for mult_packed (mmBlocking)
+//
+// Timing every candidate would take hours at large sizes, so a quick model
+// ranks them first. Candidates whose working set does not fit the cache it
+// has to live in are dropped; the rest are ranked by the traffic to that
+// cache per multiply-add, and only the best few are timed, along with the
+// defaults so tuning never makes things worse. Cache sizes come from
+// detectCaches() (mm_cache.c). Each timed candidate gets the benchmark's
+// treatment (minFlatTime() in mm_bench.c): TUNE_WARMUP runs that are not
+// counted, then the fastest of TUNE_REPS, so one noisy run cannot pick the
+// winner.
+//
+// The winners are saved to the tuning cache, one line per size, kernel and
+// CPU model:
+//
+//   <size> tiling <rows> <cols> <prods> <unroll> <GF/s> <cpu model>
+//   <size> packed-<isa> <mc> <kc> <nc> 0 <GF/s> <cpu model>
+//
+// where <isa> is the micro-kernel (packedKernelName()) the blocking was
+// tuned with, since a blocking tuned for one MR x NR does not suit another
+// that MM_ISA may force.
+//
+// and loadTuning() reads them back, so later runs on the same CPU and size
+// start with the tuned values without searching. MM_TUNE_CACHE names the
+// file; by default it is matrixmult.tune in the current directory.
+# include <stdlib.h>
+# include <stdio.h>
+# include <string.h>
+# include "matrixmult.h"
+
+#define DEFAULT_TUNE_CACHE "matrixmult.tune"
+#define MAX_LINE 512
+#define MAX_KERNEL_KEY 32       //Longest kernel field of a cache line
+#define TIMED_TILES 4           //Tile shapes timed, each at every unroll
+#define TIMED_BLOCKINGS 8       //Packed blockings timed
+#define MAX_PANEL (8 + 24)      //MR + NR of the widest micro-kernel
+#define TUNE_WARMUP 1           //Untimed runs before each candidate
+#define TUNE_REPS 3             //Timed runs of each candidate; the fastest
+                                //counts
+
+//Tile edges tried for the tiling versions
+static const int TILE_EDGES[] = { 32, 64, 128, 181, 256, 362, 512, 682 };
+#define NUM_TILE_EDGES ((int)(sizeof(TILE_EDGES) / sizeof(TILE_EDGES[0])))
+static const int UNROLLS[] = { 1, 2, 4 };
+#define NUM_UNROLLS ((int)(sizeof(UNROLLS) / sizeof(UNROLLS[0])))
+
+//Blocks tried for mult_packed; mc and nc are multiples of every MR and NR
+static const int MC_SIZES[] = { 48, 72, 96, 120, 144, 192, 240, 288, 384,
+    480, 576, 768 };
+static const int KC_SIZES[] = { 64, 96, 128, 160, 192, 256, 320, 384, 512 };
+static const int NC_SIZES[] = { 240, 480, 960, 1440, 2016, 3072, 4032 };
+#define NUM_MC ((int)(sizeof(MC_SIZES) / sizeof(MC_SIZES[0])))
+#define NUM_KC ((int)(sizeof(KC_SIZES) / sizeof(KC_SIZES[0])))
+#define NUM_NC ((int)(sizeof(NC_SIZES) / sizeof(NC_SIZES[0])))
+
+//A candidate and what the model thinks of it
+struct TileCandidate {
+    struct TileShape shape;
+    double cost;
+};
+struct BlockingCandidate {
+    struct Blocking blocking;
+    double cost;
+};
+
+//Block sizes the program started with, restored for untuned sizes
+static struct TileShape defaultTile;
+static struct Blocking defaultBlocking;
+static int haveDefaults = 0;
+
+//Remember the block sizes the program started with
+static void saveDefaults(){
+    if (!haveDefaults){
+        defaultTile = mmTile;
+        defaultBlocking = mmBlocking;
+        haveDefaults = 1;
+    }
+} //END: saveDefaults()
+
+//Name of the tuning cache file
+const char *tuningCacheName(){
+    const char *name = getenv("MM_TUNE_CACHE");
+    return name != NULL && name[0] != '\0' ? name : DEFAULT_TUNE_CACHE;
+} //END: tuningCacheName()
+
+//Average block edge when n is cut into blocks of at most edge: thin blocks
+//left over at the end make the average smaller
+static double averageEdge(int n, int edge){
+    const int blocks = (n + edge - 1) / edge;
+    return (double)n / blocks;
+} //END: averageEdge()
+
+//Model of a tile shape for tile_flat(): doubles moved to and from L2 per
+//multiply-add, or 0 if the shape is pointless
+//
+//A strip of matY one tile deep (prods lines) must stay in L1 while the
+//columns of a line are summed, and the whole matY tile in L2 while each row
+//of the tile is summed; then matY is read once per row tile, matX once per
+//column tile, and matZ read and written once per prod tile.
+static double tileCost(int n, int rows, int cols, int prods, long l1,
+        long l2){
+    if ((rows > n && rows != TILE_EDGES[0]) ||
+            (cols > n && cols != TILE_EDGES[0]) ||
+            (prods > n && prods != TILE_EDGES[0])){
+        return 0.0;             //Same as a smaller edge
+    }
+    if ((long)prods * ALIGN_BYTES > l1 ||
+            (long)prods * cols * (long)sizeof(double) > l2 / 2){
+        return 0.0;
+    }
+    return 1.0 / averageEdge(n, rows) + 1.0 / averageEdge(n, cols) +
+        2.0 / averageEdge(n, prods);
+} //END: tileCost()
+
+//Model of a packed blocking, in the same units as tileCost()
+//
+//The micro-kernel's X and Y micro-panels (kc deep) must fit in L1, the
+//packed X block in half of L2 and the packed Y panel in half of L3; then
+//matZ is read and written once per kc slice, matX packed once per nc panel
+//and the packed Y panel streamed from L3 once per mc block.
+static double blockingCost(int n, int mc, int kc, int nc, long l1, long l2,
+        long l3){
+    if ((mc > n && mc != MC_SIZES[0]) || (kc > n && kc != KC_SIZES[0]) ||
+            (nc > n && nc != NC_SIZES[0])){
+        return 0.0;
+    }
+    if ((long)kc * MAX_PANEL * (long)sizeof(double) > l1 ||
+            (long)mc * kc * (long)sizeof(double) > l2 / 2 ||
+            (long)kc * nc * (long)sizeof(double) > l3 / 2){
+        return 0.0;
+    }
+    return 2.0 / averageEdge(n, kc) + 1.0 / averageEdge(n, nc) +
+        1.0 / averageEdge(n, mc);
+} //END: blockingCost()
+
+//Sort helpers: cheapest first
+static int compareTiles(const void *a, const void *b){
+    const double x = ((const struct TileCandidate *)a)->cost;
+    const double y = ((const struct TileCandidate *)b)->cost;
+    return (x > y) - (x < y);
+} //END: compareTiles()
+
+static int compareBlockings(const void *a, const void *b){
+    const double x = ((const struct BlockingCandidate *)a)->cost;
+    const double y = ((const struct BlockingCandidate *)b)->cost;
+    return (x > y) - (x < y);
+} //END: compareBlockings()
+
+//The tiling or packed multiply with the current blocking
+static void multTiling(){
+    mult_tiling_flat(flatX, flatY, flatZ, ldFlat);
+} //END: multTiling()
+
+static void multPacked(){
+    mult_packed(numRow, numCol, numRow, flatX, ldFlat, flatY, ldFlat, flatZ,
+            ldFlat);
+} //END: multPacked()
+
+//Time the tiling or packed multiply with the current blocking
+static double timeTiling(){
+    return minFlatTime(multTiling, TUNE_WARMUP, TUNE_REPS);
+} //END: timeTiling()
+
+static double timePacked(){
+    return minFlatTime(multPacked, TUNE_WARMUP, TUNE_REPS);
+} //END: timePacked()
+
+//Kernel field of the packed lines of the tuning cache: a blocking only
+//suits the micro-kernel it was tuned with
+static void packedKey(char *key, int length){
+    snprintf(key, length, "packed-%s", packedKernelName());
+} //END: packedKey()
+
+//Replace this CPU's line for a size and kernel in the tuning cache
+static void saveTuning(int size, const char *kernel, int p1, int p2, int p3,
+        int p4, double gflops){
+    const char *name = tuningCacheName();
+    char model[128], line[MAX_LINE], tmpName[MAX_LINE];
+    FILE *in, *out;
+
+    cpuModel(model, sizeof(model));
+    snprintf(tmpName, sizeof(tmpName), "%s.tmp", name);
+    out = fopen(tmpName, "w");
+    if (out == NULL){
+        fprintf(stderr, "Could not write the tuning cache %s\n", tmpName);
+        return;
+    }
+    //Keep every other line
+    in = fopen(name, "r");
+    while (in != NULL && fgets(line, sizeof(line), in) != NULL){
+        int lineSize, skip = 0;
+        char lineKernel[MAX_KERNEL_KEY], lineModel[128];
+        if (sscanf(line, "%d %31s %*d %*d %*d %*d %*f %127[^\n]", &lineSize,
+                    lineKernel, lineModel) == 3){
+            skip = lineSize == size && strcmp(lineKernel, kernel) == 0 &&
+                strcmp(lineModel, model) == 0;
+        }
+        if (!skip){
+            fputs(line, out);
+        }
+    }
+    if (in != NULL){
+        fclose(in);
+    }
+    fprintf(out, "%d %s %d %d %d %d %.3f %s\n", size, kernel, p1, p2, p3, p4,
+            gflops, model);
+    fclose(out);
+    if (rename(tmpName, name) != 0){
+        fprintf(stderr, "Could not write the tuning cache %s\n", name);
+    }
+} //END: saveTuning()
+
+//Search the tile shapes of the tiling versions at the current size
+static void tuneTiling(long l1, long l2){
+    struct TileCandidate *candidates =
+        malloc(NUM_TILE_EDGES * NUM_TILE_EDGES * NUM_TILE_EDGES *
+                sizeof(struct TileCandidate));
+    struct TileShape best = defaultTile;
+    double bestTime;
+    int numCandidates = 0, r, c, p, u, i;
+
+    for (r = 0; r < NUM_TILE_EDGES; r++){
+        for (c = 0; c < NUM_TILE_EDGES; c++){
+            for (p = 0; p < NUM_TILE_EDGES; p++){
+                const double cost = tileCost(numRow, TILE_EDGES[r],
+                        TILE_EDGES[c], TILE_EDGES[p], l1, l2);
+                if (cost > 0.0){
+                    struct TileCandidate *cand = &candidates[numCandidates++];
+                    cand->shape.rows = TILE_EDGES[r];
+                    cand->shape.cols = TILE_EDGES[c];
+                    cand->shape.prods = TILE_EDGES[p];
+                    cand->shape.unroll = 1;
+                    cand->cost = cost;
+                }
+            }
+        }
+    }
+    qsort(candidates, numCandidates, sizeof(struct TileCandidate),
+            compareTiles);
+    printf("tiling: %d of %d shapes fit the caches, timing %d\n",
+            numCandidates, NUM_TILE_EDGES * NUM_TILE_EDGES * NUM_TILE_EDGES,
+            (numCandidates < TIMED_TILES ? numCandidates : TIMED_TILES) *
+            NUM_UNROLLS + 1);
+
+    mmTile = defaultTile;
+    bestTime = timeTiling();
+    printf("  %4d x %4d x %4d unroll %d  %8.4f s  (default)\n", mmTile.rows,
+            mmTile.cols, mmTile.prods, mmTile.unroll, bestTime);
+    for (i = 0; i < numCandidates && i < TIMED_TILES; i++){
+        for (u = 0; u < NUM_UNROLLS; u++){
+            double t;
+            mmTile = candidates[i].shape;
+            mmTile.unroll = UNROLLS[u];
+            t = timeTiling();
+            printf("  %4d x %4d x %4d unroll %d  %8.4f s\n", mmTile.rows,
+                    mmTile.cols, mmTile.prods, mmTile.unroll, t);
+            fflush(stdout);
+            if (t < bestTime){
+                bestTime = t;
+                best = mmTile;
+            }
+        }
+    }
+    mmTile = best;
+    saveTuning(numRow, "tiling", best.rows, best.cols, best.prods,
+            best.unroll, 2.0 * numRow * numCol * numRow / bestTime / 1e9);
+    free(candidates);
+} //END: tuneTiling()
+
+//Search the blocking of mult_packed at the current size
+static void tunePacked(long l1, long l2, long l3){
+    struct BlockingCandidate *candidates =
+        malloc(NUM_MC * NUM_KC * NUM_NC * sizeof(struct BlockingCandidate));
+    struct Blocking best = defaultBlocking;
+    double bestTime;
+    char key[MAX_KERNEL_KEY];
+    int numCandidates = 0, m, k, n, i;
+
+    for (m = 0; m < NUM_MC; m++){
+        for (k = 0; k < NUM_KC; k++){
+            for (n = 0; n < NUM_NC; n++){
+                const double cost = blockingCost(numRow, MC_SIZES[m],
+                        KC_SIZES[k], NC_SIZES[n], l1, l2, l3);
+                if (cost > 0.0){
+                    struct BlockingCandidate *cand =
+                        &candidates[numCandidates++];
+                    cand->blocking.mc = MC_SIZES[m];
+                    cand->blocking.kc = KC_SIZES[k];
+                    cand->blocking.nc = NC_SIZES[n];
+                    cand->cost = cost;
+                }
+            }
+        }
+    }
+    qsort(candidates, numCandidates, sizeof(struct BlockingCandidate),
+            compareBlockings);
+    printf("packed: %d of %d blockings fit the caches, timing %d\n",
+            numCandidates, NUM_MC * NUM_KC * NUM_NC,
+            (numCandidates < TIMED_BLOCKINGS ? numCandidates :
+             TIMED_BLOCKINGS) + 1);
+
+    mmBlocking = defaultBlocking;
+    bestTime = timePacked();
+    printf("  %4d x %4d x %4d  %8.4f s  (default)\n", mmBlocking.mc,
+            mmBlocking.kc, mmBlocking.nc, bestTime);
+    for (i = 0; i < numCandidates && i < TIMED_BLOCKINGS; i++){
+        double t;
+        mmBlocking = candidates[i].blocking;
+        t = timePacked();
+        printf("  %4d x %4d x %4d  %8.4f s\n", mmBlocking.mc, mmBlocking.kc,
+                mmBlocking.nc, t);
+        fflush(stdout);
+        if (t < bestTime){
+            bestTime = t;
+            best = mmBlocking;
+        }
+    }
+    mmBlocking = best;
+    packedKey(key, sizeof(key));
+    saveTuning(numRow, key, best.mc, best.kc, best.nc, 0,
+            2.0 * numRow * numCol * numRow / bestTime / 1e9);
+    free(candidates);
+} //END: tunePacked()
+
+//Search the block sizes of the tiling and packed multiplies at the current
+//size, on the contiguous matrices, and save the best to the tuning cache
+void tuneBlocking(){
+    long l1, l2, l3;
+
+    detectCaches();
+    l1 = mmCaches[0].bytes;
+    l2 = mmCaches[1].bytes;
+    l3 = mmCaches[2].bytes > 0 ? mmCaches[2].bytes : l2;
+    saveDefaults();
+    printf("Tuning size %d for L1 %ld KB, L2 %ld KB, L3 %ld KB\n", numRow,
+            l1 / 1024, l2 / 1024, l3 / 1024);
+    tuneTiling(l1, l2);
+    tunePacked(l1, l2, l3);
+    printf("Saved to %s\n", tuningCacheName());
+} //END: tuneBlocking()
+
+//Set the block sizes tuned for this CPU and size, or the defaults
+//
+//@return how many kernels were tuned for them: 0, 1 or 2
+int loadTuning(int size){
+    char model[128], line[MAX_LINE], packed[MAX_KERNEL_KEY];
+    FILE *in;
+    int found = 0;
+
+    saveDefaults();
+    packedKey(packed, sizeof(packed));
+    mmTile = defaultTile;
+    mmBlocking = defaultBlocking;
+    in = fopen(tuningCacheName(), "r");
+    if (in == NULL){
+        return 0;
+    }
+    cpuModel(model, sizeof(model));
+    while (fgets(line, sizeof(line), in) != NULL){
+        int lineSize, p1, p2, p3, p4;
+        char kernel[MAX_KERNEL_KEY], lineModel[128];
+        if (sscanf(line, "%d %31s %d %d %d %d %*f %127[^\n]", &lineSize,
+                    kernel, &p1, &p2, &p3, &p4, lineModel) != 7 ||
+                lineSize != size || strcmp(lineModel, model) != 0 ||
+                p1 < 1 || p2 < 1 || p3 < 1){
+            continue;
+        }
+        if (strcmp(kernel, "tiling") == 0 &&
+                (p4 == 1 || p4 == 2 || p4 == 4)){
+            mmTile.rows = p1;
+            mmTile.cols = p2;
+            mmTile.prods = p3;
+            mmTile.unroll = p4;
+            found++;
+        } else if (strcmp(kernel, packed) == 0){
+            mmBlocking.mc = p1;
+            mmBlocking.kc = p2;
+            mmBlocking.nc = p3;
+            found++;
+        }
+    }
+    fclose(in);
+    return found;
+} //END: loadTuning()